@@ -0,0 +1,71 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "rpgtools/random_number_generator.h"
+#include "rpgtools/expression_evaluator.h"
+#include "rpgtools/distribution_table.h"
+
+void print_usage()
+{
+    std::cout << "Usage:\n"
+              << "   disttable write [path]               Write the standard table (default: dice.dist)\n"
+              << "   disttable query [path] term target   Print P(term >= target) and P(term <= target)\n"
+              << "\n"
+              << "   Example: disttable query dice.dist 4d6b3 15\n"
+              << "\n";
+}
+
+auto main(int argc, char* argv[]) -> int
+{
+    if (argc < 2)
+    {
+        print_usage();
+        return 0;
+    }
+
+    try
+    {
+        std::string command = argv[1];
+        if (command == "write" && argc <= 3)
+        {
+            std::string path = argc == 3 ? argv[2] : "dice.dist";
+            auto terms = standard_distribution_terms();
+
+            auto start = std::chrono::steady_clock::now();
+            write_distribution_table(path, terms);
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            distribution_table table{ path };
+            std::cout << "Wrote " << table.size() << " distributions to " << path << " in " << std::fixed
+                      << std::setprecision(2) << elapsed << " s\n";
+        }
+        else if (command == "query" && (argc == 4 || argc == 5))
+        {
+            std::string path = argc == 5 ? argv[2] : "dice.dist";
+            std::string token = argv[argc - 2];
+            auto target = std::stoi(argv[argc - 1]);
+
+            distribution_table table{ path };
+            expression_evaluator parser{ nullptr };
+            auto term = parser.parse_dice_expression(token);
+
+            std::cout << std::setprecision(10);
+            std::cout << "P(" << token << " >= " << target << ") = " << table.probability_at_least(term, target)
+                      << "\n";
+            std::cout << "P(" << token << " <= " << target << ") = " << table.probability_at_most(term, target)
+                      << "\n";
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << "\n";
+        return 1;
+    }
+}
@@ -1,11 +1,6 @@
-#include <algorithm>
 #include <iostream>
-#include <unordered_map>
-#include <numeric>
-#include <random>
-#include <regex>
-#include <stack>
-#include <sstream>
+#include <string>
+#include <string_view>
 #include <vector>
 #include "rpgtools/random_number_generator.h"
 #include "rpgtools/expression_evaluator.h"
@@ -15,29 +10,67 @@ auto main(int argc, char* argv[]) -> int
     if (argc < 2)
     {
         std::cout << "Usage:\n"
-                  << "   [expression] (... [expression])\n"
+                  << "   [-s] [expression] (... [expression])\n"
                   << "\n"
                   << "   Simple dice rolls: 1d4 1d4+3\n"
                   << "   Keep best/worst: 4d6b3 2d20b1+3\n"
+                  << "   Repetition: 6x(4d6b3) 100x(2d6+3)\n"
+                  << "   Target numbers: 1d20+7>=15 d100<=45\n"
+                  << "\n"
+                  << "   -s  List repeated results highest first\n"
                   << "\n";
         return 0;
     }
 
-    try
+    // One generator and evaluator for every argument, so their state and scratch memory carry over between rolls
+    random_number_generator rng{};
+    expression_evaluator parser{ &rng };
+    std::string roll_description{};
+    std::vector<int> results{};
+    bool sorted{ false };
+
+    for (int x = 1; x < argc; x++)
     {
-        for (int x = 1; x < argc; x++)
+        std::string_view expression{ argv[x] };
+        if (expression == "-s")
+        {
+            sorted = true;
+            continue;
+        }
+
+        // A bad expression is reported and the remaining arguments are still rolled
+        try
         {
-            std::string roll_description{};
-            random_number_generator rng{};
-            expression_evaluator parser{ &rng };
+            std::size_t count{ 0 };
+            std::string_view inner{};
+            if (parser.parse_repetition(expression, count, inner))
+            {
+                auto sum = parser.evaluate_repeated(expression, results, sorted);
 
-            auto result = parser.evaluate(argv[x], &roll_description);
+                std::cout << expression << ": ";
+                for (std::size_t i = 0; i < results.size(); ++i)
+                {
+                    std::cout << (i > 0 ? ", " : "") << results[i];
+                }
+                std::cout << " (sum " << sum << ")\n";
+            }
+            else if (parser.is_check(expression))
+            {
+                auto check = parser.evaluate_check(expression, &roll_description);
 
-            std::cout << argv[x] << ": " << roll_description << " = " << result << "\n";
+                std::cout << expression << ": " << roll_description << " = " << check.total << ", "
+                          << (check.success ? "pass" : "fail") << ", margin " << check.margin << "\n";
+            }
+            else
+            {
+                auto result = parser.evaluate(expression, &roll_description);
+
+                std::cout << expression << ": " << roll_description << " = " << result << "\n";
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << expression << ": " << e.what() << "\n";
         }
-    }
-    catch (const std::exception& e)
-    {
-        std::cout << e.what() << "\n";
     }
 }
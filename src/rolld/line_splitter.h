@@ -0,0 +1,88 @@
+#pragma once
+//
+// Splits the bytes a client sends into request lines for rolld.
+//
+// Lines end with "\n" or "\r\n" and may arrive across any number of reads. A line longer than the limit is reported
+// exactly once, whether it arrived whole or in pieces, and everything up to its newline is then skipped, so every
+// request line gets exactly one response and pipelined clients can keep matching responses to requests in order.
+//
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+class line_splitter
+{
+public:
+    explicit line_splitter(std::size_t max_length) : max_length_{ max_length }
+    {
+    }
+
+    // Calls on_line(std::string_view) for each complete line in data, and on_overlong() once for each line longer
+    // than max_length. A trailing partial line is kept for the next call.
+    template <typename Line, typename Overlong>
+    void feed(std::string_view data, Line&& on_line, Overlong&& on_overlong)
+    {
+        std::size_t start = 0;
+        while (start < data.size())
+        {
+            auto end = data.find('\n', start);
+            if (end == std::string_view::npos)
+            {
+                if (!discarding_)
+                {
+                    partial_.append(data.substr(start));
+
+                    // One more character is allowed for a '\r' that may turn out to end the line
+                    if (partial_.size() > max_length_ + 1)
+                    {
+                        on_overlong();
+                        partial_.clear();
+                        discarding_ = true;
+                    }
+                }
+                return;
+            }
+
+            if (discarding_)
+            {
+                // The newline that ends a line already reported as too long
+                discarding_ = false;
+            }
+            else
+            {
+                auto line = data.substr(start, end - start);
+                if (!partial_.empty())
+                {
+                    partial_.append(line);
+                    line = partial_;
+                }
+                if (!line.empty() && line.back() == '\r')
+                {
+                    line.remove_suffix(1);
+                }
+
+                if (line.size() > max_length_)
+                {
+                    on_overlong();
+                }
+                else
+                {
+                    on_line(line);
+                }
+                partial_.clear();
+            }
+            start = end + 1;
+        }
+    }
+
+    // Bytes held for a line that hasn't ended yet
+    std::size_t buffered() const
+    {
+        return partial_.size();
+    }
+
+private:
+    std::size_t max_length_;
+    std::string partial_;
+    bool discarding_{ false };
+};
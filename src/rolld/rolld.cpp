@@ -0,0 +1,558 @@
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "rolld/line_splitter.h"
+#include "rolld/rolld_socket.h"
+#include "rpgtools/random_number_generator.h"
+#include "rpgtools/expression_evaluator.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE 0
+#endif
+#endif
+
+std::atomic<bool> stopping{ false };
+
+void request_stop(int)
+{
+    stopping = true;
+}
+
+struct poll_event
+{
+    socket_handle socket;
+    bool readable;
+    bool writable;
+    bool hangup;
+};
+
+//
+// Readiness notification for one worker: epoll on Linux, poll()/WSAPoll elsewhere
+//
+
+#ifdef __linux__
+class poller
+{
+    int epoll_fd_;
+    std::vector<epoll_event> ready_;
+
+public:
+    poller() : epoll_fd_{ epoll_create1(0) }, ready_(256)
+    {
+        if (epoll_fd_ < 0)
+        {
+            throw std::runtime_error("epoll_create1: " + last_socket_error());
+        }
+    }
+
+    ~poller()
+    {
+        close(epoll_fd_);
+    }
+
+    poller(const poller&) = delete;
+    poller& operator=(const poller&) = delete;
+
+    // Listening sockets are shared by every worker; EPOLLEXCLUSIVE wakes only one of them per connection
+    void add(socket_handle s, bool is_listener)
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        if (is_listener)
+        {
+            ev.events |= EPOLLEXCLUSIVE;
+        }
+        ev.data.fd = s;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, s, &ev);
+    }
+
+    void set_interest(socket_handle s, bool read, bool write)
+    {
+        epoll_event ev{};
+        ev.events = (read ? EPOLLIN : 0u) | (write ? EPOLLOUT : 0u);
+        ev.data.fd = s;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, s, &ev);
+    }
+
+    void remove(socket_handle s)
+    {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, s, nullptr);
+    }
+
+    void wait(std::vector<poll_event>& events, int timeout_ms)
+    {
+        events.clear();
+        auto count = epoll_wait(epoll_fd_, ready_.data(), static_cast<int>(ready_.size()), timeout_ms);
+        for (int i = 0; i < count; ++i)
+        {
+            const auto& ev = ready_[i];
+            events.push_back({ ev.data.fd, (ev.events & EPOLLIN) != 0, (ev.events & EPOLLOUT) != 0,
+                               (ev.events & (EPOLLHUP | EPOLLERR)) != 0 });
+        }
+    }
+};
+#else
+class poller
+{
+    std::vector<pollfd> sockets_;
+
+    std::vector<pollfd>::iterator find(socket_handle s)
+    {
+        for (auto it = sockets_.begin(); it != sockets_.end(); ++it)
+        {
+            if (it->fd == s)
+            {
+                return it;
+            }
+        }
+        return sockets_.end();
+    }
+
+public:
+    void add(socket_handle s, bool)
+    {
+        sockets_.push_back({ s, POLLIN, 0 });
+    }
+
+    void set_interest(socket_handle s, bool read, bool write)
+    {
+        auto it = find(s);
+        if (it != sockets_.end())
+        {
+            it->events = static_cast<short>((read ? POLLIN : 0) | (write ? POLLOUT : 0));
+        }
+    }
+
+    void remove(socket_handle s)
+    {
+        auto it = find(s);
+        if (it != sockets_.end())
+        {
+            sockets_.erase(it);
+        }
+    }
+
+    void wait(std::vector<poll_event>& events, int timeout_ms)
+    {
+        events.clear();
+        if (poll_sockets(sockets_.data(), sockets_.size(), timeout_ms) <= 0)
+        {
+            return;
+        }
+        for (const auto& s : sockets_)
+        {
+            if (s.revents)
+            {
+                events.push_back({ s.fd, (s.revents & POLLIN) != 0, (s.revents & POLLOUT) != 0,
+                                   (s.revents & (POLLHUP | POLLERR)) != 0 });
+            }
+        }
+    }
+};
+#endif
+
+//
+// Worker: one event loop with its own evaluator, RNG and parse cache. Connections stay on the worker that accepted
+// them, so responses never need to cross threads and always go out in request order.
+//
+
+std::string escape_json(const std::string& text)
+{
+    std::string result;
+    result.reserve(text.size());
+    for (auto c : text)
+    {
+        switch (c)
+        {
+        case '"':
+            result += "\\\"";
+            break;
+
+        case '\\':
+            result += "\\\\";
+            break;
+
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                result += ' ';
+            }
+            else
+            {
+                result += c;
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+class worker
+{
+    static const std::size_t max_line_length = 4096;
+    static const std::size_t max_cached_expressions = 1024;
+
+    // A connection stops being read while this much output is waiting to be sent, so a client that pipelines
+    // requests without reading the responses can't grow the server's memory
+    static const std::size_t max_pending_output = 1024 * 1024;
+
+    enum class read_status { open, peer_closed, failed };
+
+    struct connection
+    {
+        line_splitter input{ max_line_length };
+        std::string output;
+        std::size_t output_offset{ 0 };
+        bool peer_closed{ false };   // The client has shut down its side; close once the output is flushed
+        bool read_interest{ true };
+        bool write_interest{ false };
+
+        std::size_t pending_output() const
+        {
+            return output.size() - output_offset;
+        }
+    };
+
+    random_number_generator rng_;
+    expression_evaluator evaluator_{ &rng_ };
+    std::unordered_map<std::string, std::vector<std::string>> prefix_cache_;
+    std::unordered_map<socket_handle, connection> connections_;
+    std::vector<socket_handle> listeners_;
+    poller poller_;
+
+    bool is_listener(socket_handle s) const
+    {
+        for (auto listener : listeners_)
+        {
+            if (listener == s)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void accept_connections(socket_handle listener)
+    {
+        while (true)
+        {
+            auto s = accept(listener, nullptr, nullptr);
+            if (s == invalid_socket_handle)
+            {
+                return;   // Another worker won the race, or the backlog is drained
+            }
+            set_nonblocking(s);
+            set_nodelay(s);
+            connections_.emplace(s, connection{});
+            poller_.add(s, false);
+        }
+    }
+
+    void close_connection(socket_handle s)
+    {
+        poller_.remove(s);
+        close_socket(s);
+        connections_.erase(s);
+    }
+
+    void evaluate_line(const std::string& line, std::string& output)
+    {
+        try
+        {
+            auto it = prefix_cache_.find(line);
+            if (it == prefix_cache_.end())
+            {
+                auto prefix = evaluator_.convert_infix_to_prefix(evaluator_.parse(line));
+                if (prefix_cache_.size() >= max_cached_expressions)
+                {
+                    prefix_cache_.clear();
+                }
+                it = prefix_cache_.emplace(line, std::move(prefix)).first;
+            }
+
+            std::string description;
+            auto result = evaluator_.evaluate_prefix(it->second, &description);
+            output += "{\"result\":" + std::to_string(result) + ",\"description\":\"" + escape_json(description) +
+                      "\"}\n";
+        }
+        catch (const std::exception& e)
+        {
+            output += "{\"error\":\"" + escape_json(e.what()) + "\"}\n";
+        }
+    }
+
+    // Evaluates every complete line in data as one batch. A line over max_line_length gets a single error response,
+    // however many reads it arrives in.
+    void process_input(connection& conn, std::string_view data)
+    {
+        auto on_line = [&](std::string_view line) { evaluate_line(std::string{ line }, conn.output); };
+        auto on_overlong = [&]() { conn.output += "{\"error\":\"Line too long\"}\n"; };
+        conn.input.feed(data, on_line, on_overlong);
+    }
+
+    // Reads and evaluates one buffer at a time, so the input never holds more than one partial line,
+    // and stops early once the output backs up
+    read_status read_available(socket_handle s, connection& conn)
+    {
+        char buffer[65536];
+        while (conn.pending_output() < max_pending_output)
+        {
+            auto received = recv(s, buffer, sizeof(buffer), 0);
+            if (received > 0)
+            {
+                process_input(conn, std::string_view(buffer, static_cast<std::size_t>(received)));
+                continue;
+            }
+            if (received == 0)
+            {
+                return read_status::peer_closed;
+            }
+            return last_error_would_block() ? read_status::open : read_status::failed;
+        }
+        return read_status::open;
+    }
+
+    // Returns false when the peer has gone away
+    bool flush(socket_handle s, connection& conn)
+    {
+        while (conn.output_offset < conn.output.size())
+        {
+            auto sent = send(s, conn.output.data() + conn.output_offset,
+                             static_cast<int>(conn.output.size() - conn.output_offset), 0);
+            if (sent < 0)
+            {
+                return last_error_would_block();
+            }
+            conn.output_offset += static_cast<std::size_t>(sent);
+        }
+
+        conn.output.clear();
+        conn.output_offset = 0;
+        return true;
+    }
+
+    // Reads while the client is open and the output isn't backed up; waits for writability while output is pending
+    void update_interest(socket_handle s, connection& conn)
+    {
+        auto read = !conn.peer_closed && conn.pending_output() < max_pending_output;
+        auto write = conn.pending_output() > 0;
+        if (read != conn.read_interest || write != conn.write_interest)
+        {
+            conn.read_interest = read;
+            conn.write_interest = write;
+            poller_.set_interest(s, read, write);
+        }
+    }
+
+public:
+    worker(const std::vector<socket_handle>& listeners, unsigned seed) : rng_{ seed }, listeners_{ listeners }
+    {
+        for (auto listener : listeners_)
+        {
+            poller_.add(listener, true);
+        }
+    }
+
+    ~worker()
+    {
+        for (const auto& entry : connections_)
+        {
+            close_socket(entry.first);
+        }
+    }
+
+    void run()
+    {
+        std::vector<poll_event> events;
+        while (!stopping)
+        {
+            poller_.wait(events, 250);
+            for (const auto& ev : events)
+            {
+                if (is_listener(ev.socket))
+                {
+                    accept_connections(ev.socket);
+                    continue;
+                }
+
+                auto it = connections_.find(ev.socket);
+                if (it == connections_.end())
+                {
+                    continue;
+                }
+
+                auto& conn = it->second;
+                auto alive = true;
+                if ((ev.readable || ev.hangup) && conn.read_interest)
+                {
+                    // Responses to everything received before an EOF are still owed, so only a failed read ends the
+                    // connection here
+                    auto status = read_available(ev.socket, conn);
+                    alive = status != read_status::failed;
+                    conn.peer_closed = conn.peer_closed || status == read_status::peer_closed;
+                }
+                if (alive && conn.pending_output() > 0)
+                {
+                    alive = flush(ev.socket, conn);
+                }
+                if (alive && conn.peer_closed && conn.pending_output() == 0)
+                {
+                    alive = false;
+                }
+
+                if (alive)
+                {
+                    update_interest(ev.socket, conn);
+                }
+                else
+                {
+                    close_connection(ev.socket);
+                }
+            }
+        }
+    }
+};
+
+//
+// Driver
+//
+
+void print_usage()
+{
+    std::cout << "Usage:\n"
+              << "   rolld [-p port] [-b address] [-u socket_path] [-w workers]\n"
+              << "\n"
+              << "   Serves dice expressions, one per line, answering each with a JSON line.\n"
+              << "   Listens on 127.0.0.1:" << rolld_default_port << " unless -u is given without -p.\n"
+              << "\n";
+}
+
+auto main(int argc, char* argv[]) -> int
+{
+    std::string bind_address = "127.0.0.1";
+    std::string unix_path;
+    int port = -1;
+    unsigned worker_count = std::max(1u, std::thread::hardware_concurrency());
+
+    try
+    {
+        for (int x = 1; x < argc; x++)
+        {
+            std::string arg = argv[x];
+            if (arg == "-h" || arg == "--help")
+            {
+                print_usage();
+                return 0;
+            }
+            if (x + 1 >= argc)
+            {
+                throw std::runtime_error("Missing value for option: " + arg);
+            }
+
+            std::string value = argv[++x];
+            if (arg == "-p")
+            {
+                port = std::stoi(value);
+            }
+            else if (arg == "-b")
+            {
+                bind_address = value;
+            }
+            else if (arg == "-u")
+            {
+#ifdef _WIN32
+                throw std::runtime_error("Unix domain sockets are not supported on this platform");
+#else
+                unix_path = value;
+#endif
+            }
+            else if (arg == "-w")
+            {
+                worker_count = static_cast<unsigned>(std::max(1, std::stoi(value)));
+            }
+            else
+            {
+                throw std::runtime_error("Unknown option: " + arg);
+            }
+        }
+
+        if (port < 0 && unix_path.empty())
+        {
+            port = rolld_default_port;
+        }
+
+        socket_library sockets;
+        std::vector<socket_handle> listeners;
+        if (port >= 0)
+        {
+            listeners.push_back(listen_tcp(bind_address, port));
+            std::cout << "rolld: listening on " << bind_address << ":" << port << "\n";
+        }
+#ifndef _WIN32
+        if (!unix_path.empty())
+        {
+            listeners.push_back(listen_unix(unix_path));
+            std::cout << "rolld: listening on " << unix_path << "\n";
+        }
+        std::signal(SIGPIPE, SIG_IGN);
+#endif
+        for (auto listener : listeners)
+        {
+            set_nonblocking(listener);
+        }
+
+        std::signal(SIGINT, request_stop);
+        std::signal(SIGTERM, request_stop);
+
+        std::random_device seed_source;
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < worker_count; ++i)
+        {
+            auto seed = seed_source();
+            threads.emplace_back([&listeners, seed]() {
+                try
+                {
+                    worker w{ listeners, seed };
+                    w.run();
+                }
+                catch (const std::exception& e)
+                {
+                    std::cout << "rolld: worker failed: " << e.what() << std::endl;
+                    stopping = true;
+                }
+            });
+        }
+        std::cout << "rolld: " << worker_count << " workers" << std::endl;
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (auto listener : listeners)
+        {
+            close_socket(listener);
+        }
+#ifndef _WIN32
+        if (!unix_path.empty())
+        {
+            unlink(unix_path.c_str());
+        }
+#endif
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,223 @@
+#pragma once
+//
+// Socket helpers shared by rolld and its load generator.
+//
+// Wire protocol: the client sends one expression per line ("4d6b3+2\n"). The server answers every line, in order,
+// with one JSON object per line:
+//
+//     {"result":15,"description":"(5, 4, 6, 2)"}
+//     {"error":"Improper dice expression: 1dx"}
+//
+// Clients may pipeline any number of lines in a single write; the server evaluates everything that arrived in one
+// read as a batch and returns the responses in as few writes as the socket allows.
+//
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+using socket_handle = SOCKET;
+const socket_handle invalid_socket_handle = INVALID_SOCKET;
+#else
+using socket_handle = int;
+const socket_handle invalid_socket_handle = -1;
+#endif
+
+const int rolld_default_port = 4666;
+
+// Initializes the platform socket library for the lifetime of the object
+class socket_library
+{
+public:
+    socket_library()
+    {
+#ifdef _WIN32
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        {
+            throw std::runtime_error("WSAStartup failed");
+        }
+#endif
+    }
+
+    ~socket_library()
+    {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    socket_library(const socket_library&) = delete;
+    socket_library& operator=(const socket_library&) = delete;
+};
+
+inline std::string last_socket_error()
+{
+#ifdef _WIN32
+    return "socket error " + std::to_string(WSAGetLastError());
+#else
+    return std::strerror(errno);
+#endif
+}
+
+inline bool last_error_would_block()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+inline void close_socket(socket_handle s)
+{
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+inline void set_nonblocking(socket_handle s)
+{
+#ifdef _WIN32
+    u_long enabled = 1;
+    ioctlsocket(s, FIONBIO, &enabled);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+inline void set_nodelay(socket_handle s)
+{
+    int enabled = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+}
+
+// poll() with the platform's spelling
+inline int poll_sockets(pollfd* fds, std::size_t count, int timeout_ms)
+{
+#ifdef _WIN32
+    return WSAPoll(fds, static_cast<ULONG>(count), timeout_ms);
+#else
+    return poll(fds, static_cast<nfds_t>(count), timeout_ms);
+#endif
+}
+
+inline sockaddr_in make_tcp_address(const std::string& host, int port)
+{
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(port));
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+    {
+        throw std::runtime_error("Invalid IPv4 address: " + host);
+    }
+    return address;
+}
+
+inline socket_handle listen_tcp(const std::string& host, int port)
+{
+    auto address = make_tcp_address(host, port);
+    auto s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == invalid_socket_handle)
+    {
+        throw std::runtime_error("socket: " + last_socket_error());
+    }
+
+    int enabled = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+    if (bind(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(s, SOMAXCONN) != 0)
+    {
+        auto error = last_socket_error();
+        close_socket(s);
+        throw std::runtime_error("Unable to listen on " + host + ":" + std::to_string(port) + ": " + error);
+    }
+    return s;
+}
+
+inline socket_handle connect_tcp(const std::string& host, int port)
+{
+    auto address = make_tcp_address(host, port);
+    auto s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == invalid_socket_handle)
+    {
+        throw std::runtime_error("socket: " + last_socket_error());
+    }
+
+    if (connect(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        auto error = last_socket_error();
+        close_socket(s);
+        throw std::runtime_error("Unable to connect to " + host + ":" + std::to_string(port) + ": " + error);
+    }
+    set_nodelay(s);
+    return s;
+}
+
+#ifndef _WIN32
+inline sockaddr_un make_unix_address(const std::string& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+inline socket_handle listen_unix(const std::string& path)
+{
+    auto address = make_unix_address(path);
+    auto s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == invalid_socket_handle)
+    {
+        throw std::runtime_error("socket: " + last_socket_error());
+    }
+
+    unlink(path.c_str());
+    if (bind(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(s, SOMAXCONN) != 0)
+    {
+        auto error = last_socket_error();
+        close_socket(s);
+        throw std::runtime_error("Unable to listen on " + path + ": " + error);
+    }
+    return s;
+}
+
+inline socket_handle connect_unix(const std::string& path)
+{
+    auto address = make_unix_address(path);
+    auto s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == invalid_socket_handle)
+    {
+        throw std::runtime_error("socket: " + last_socket_error());
+    }
+
+    if (connect(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        auto error = last_socket_error();
+        close_socket(s);
+        throw std::runtime_error("Unable to connect to " + path + ": " + error);
+    }
+    return s;
+}
+#endif
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "rolld/rolld_socket.h"
+
+using load_clock = std::chrono::steady_clock;
+
+struct options
+{
+    std::string host{ "127.0.0.1" };
+    int port{ rolld_default_port };
+    std::string unix_path;
+    unsigned connections{ 4 };
+    std::size_t requests{ 100000 };   // Per connection
+    std::size_t pipeline{ 64 };       // Requests per write
+    std::string expression{ "4d6b3+2" };
+};
+
+struct connection_result
+{
+    std::vector<double> latencies_us;   // One entry per request
+    std::size_t errors{ 0 };
+};
+
+socket_handle open_connection(const options& opts)
+{
+#ifndef _WIN32
+    if (!opts.unix_path.empty())
+    {
+        return connect_unix(opts.unix_path);
+    }
+#endif
+    return connect_tcp(opts.host, opts.port);
+}
+
+void send_all(socket_handle s, const std::string& data)
+{
+    std::size_t offset = 0;
+    while (offset < data.size())
+    {
+        auto sent = send(s, data.data() + offset, static_cast<int>(data.size() - offset), 0);
+        if (sent <= 0)
+        {
+            throw std::runtime_error("send: " + last_socket_error());
+        }
+        offset += static_cast<std::size_t>(sent);
+    }
+}
+
+// Sends requests in pipelined batches and times each batch's round trip. Every request in a batch is charged the
+// batch latency, since that is when its response becomes available to the caller.
+void run_connection(const options& opts, connection_result& result)
+{
+    auto s = open_connection(opts);
+
+    std::string batch;
+    for (std::size_t i = 0; i < opts.pipeline; ++i)
+    {
+        batch += opts.expression + "\n";
+    }
+
+    std::string pending;
+    char buffer[65536];
+    result.latencies_us.reserve(opts.requests);
+
+    for (std::size_t done = 0; done < opts.requests;)
+    {
+        auto count = std::min(opts.pipeline, opts.requests - done);
+        auto start = load_clock::now();
+        send_all(s, count == opts.pipeline ? batch : batch.substr(0, count * (opts.expression.size() + 1)));
+
+        std::size_t responses = 0;
+        while (responses < count)
+        {
+            auto received = recv(s, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                close_socket(s);
+                throw std::runtime_error("Connection closed by server");
+            }
+            pending.append(buffer, static_cast<std::size_t>(received));
+
+            std::size_t start_of_line = 0;
+            std::size_t end;
+            while ((end = pending.find('\n', start_of_line)) != std::string::npos)
+            {
+                if (pending.compare(start_of_line, 9, "{\"error\":") == 0)
+                {
+                    ++result.errors;
+                }
+                ++responses;
+                start_of_line = end + 1;
+            }
+            pending.erase(0, start_of_line);
+        }
+
+        auto latency = std::chrono::duration<double, std::micro>(load_clock::now() - start).count();
+        result.latencies_us.insert(result.latencies_us.end(), count, latency);
+        done += count;
+    }
+
+    close_socket(s);
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    auto index = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+void print_usage()
+{
+    std::cout << "Usage:\n"
+              << "   rollload [-p port] [-H host] [-u socket_path] [-c connections] [-n requests] [-d depth]\n"
+              << "            [-e expression]\n"
+              << "\n"
+              << "   Drives rolld with pipelined requests and reports requests/second and p50/p99 latency.\n"
+              << "   -n is per connection; -d is how many requests are written per batch.\n"
+              << "\n";
+}
+
+auto main(int argc, char* argv[]) -> int
+{
+    options opts;
+
+    try
+    {
+        for (int x = 1; x < argc; x++)
+        {
+            std::string arg = argv[x];
+            if (arg == "-h" || arg == "--help")
+            {
+                print_usage();
+                return 0;
+            }
+            if (x + 1 >= argc)
+            {
+                throw std::runtime_error("Missing value for option: " + arg);
+            }
+
+            std::string value = argv[++x];
+            if (arg == "-p")
+            {
+                opts.port = std::stoi(value);
+            }
+            else if (arg == "-H")
+            {
+                opts.host = value;
+            }
+            else if (arg == "-u")
+            {
+#ifdef _WIN32
+                throw std::runtime_error("Unix domain sockets are not supported on this platform");
+#else
+                opts.unix_path = value;
+#endif
+            }
+            else if (arg == "-c")
+            {
+                opts.connections = static_cast<unsigned>(std::max(1, std::stoi(value)));
+            }
+            else if (arg == "-n")
+            {
+                opts.requests = std::stoull(value);
+            }
+            else if (arg == "-d")
+            {
+                opts.pipeline = std::max<std::size_t>(1, std::stoull(value));
+            }
+            else if (arg == "-e")
+            {
+                opts.expression = value;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown option: " + arg);
+            }
+        }
+
+        socket_library sockets;
+        std::vector<connection_result> results(opts.connections);
+        std::vector<std::string> failures(opts.connections);
+        std::vector<std::thread> threads;
+
+        auto start = load_clock::now();
+        for (unsigned i = 0; i < opts.connections; ++i)
+        {
+            threads.emplace_back([&, i]() {
+                try
+                {
+                    run_connection(opts, results[i]);
+                }
+                catch (const std::exception& e)
+                {
+                    failures[i] = e.what();
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        auto elapsed = std::chrono::duration<double>(load_clock::now() - start).count();
+
+        std::vector<double> latencies;
+        std::size_t errors = 0;
+        for (unsigned i = 0; i < opts.connections; ++i)
+        {
+            if (!failures[i].empty())
+            {
+                throw std::runtime_error("Connection " + std::to_string(i) + ": " + failures[i]);
+            }
+            latencies.insert(latencies.end(), results[i].latencies_us.begin(), results[i].latencies_us.end());
+            errors += results[i].errors;
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "expression:  " << opts.expression << "\n"
+                  << "connections: " << opts.connections << "  depth: " << opts.pipeline << "\n"
+                  << "requests:    " << latencies.size() << " (" << errors << " errors) in " << elapsed << " s\n"
+                  << "throughput:  " << latencies.size() / elapsed << " requests/s\n"
+                  << "latency:     p50 " << percentile(latencies, 0.50) << " us, p99 " << percentile(latencies, 0.99)
+                  << " us\n";
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include "custom_die.h"
+
+namespace
+{
+    bool is_letter(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    bool is_name_char(char c)
+    {
+        return is_letter(c) || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && text.front() == ' ')
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && text.back() == ' ')
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    template <typename T>
+    bool parse_number(std::string_view text, T& value)
+    {
+        text = trim(text);
+        if (!text.empty() && text.front() == '+')
+        {
+            text.remove_prefix(1);
+        }
+        auto end = text.data() + text.size();
+        auto result = std::from_chars(text.data(), end, value);
+        return !text.empty() && result.ec == std::errc{} && result.ptr == end;
+    }
+}
+
+//
+// custom_die
+//
+
+custom_die::custom_die(std::vector<int> faces, std::vector<double> weights) : faces_{ std::move(faces) }
+{
+    auto n = faces_.size();
+    if (n == 0)
+    {
+        throw std::runtime_error("Custom die needs at least one face");
+    }
+    if (weights.empty())
+    {
+        weights.assign(n, 1.0);
+    }
+    if (weights.size() != n)
+    {
+        throw std::runtime_error("Custom die needs one weight per face");
+    }
+
+    double total{ 0.0 };
+    for (auto weight : weights)
+    {
+        if (!(weight > 0.0) || !std::isfinite(weight))
+        {
+            throw std::runtime_error("Custom die weights must be positive");
+        }
+        total += weight;
+    }
+
+    //
+    // Vose's alias method: scale each probability by the face count, then repeatedly pair a column that is under
+    // 1 with one that is over, topping up the small column with its alias.
+    //
+
+    std::vector<double> scaled(n);
+    std::vector<std::size_t> small;
+    std::vector<std::size_t> large;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        scaled[i] = weights[i] / total * static_cast<double>(n);
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    threshold_.assign(n, 1u << word_bits);
+    alias_.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        alias_[i] = static_cast<std::uint32_t>(i);
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        auto low = small.back();
+        small.pop_back();
+        auto high = large.back();
+        large.pop_back();
+
+        threshold_[low] = static_cast<std::uint32_t>(std::llround(scaled[low] * (1u << word_bits)));
+        alias_[low] = static_cast<std::uint32_t>(high);
+
+        scaled[high] = (scaled[high] + scaled[low]) - 1.0;
+        (scaled[high] < 1.0 ? small : large).push_back(high);
+    }
+
+    // Whatever is left is 1 up to rounding error and keeps its own face
+}
+
+const std::vector<int>& custom_die::faces() const
+{
+    return faces_;
+}
+
+int custom_die::min_face() const
+{
+    return *std::min_element(faces_.begin(), faces_.end());
+}
+
+int custom_die::max_face() const
+{
+    return *std::max_element(faces_.begin(), faces_.end());
+}
+
+std::vector<double> custom_die::probabilities() const
+{
+    // Each column is picked with chance 1/n, then keeps its own face for threshold / 2^31 of the fractions
+    const auto n = static_cast<double>(faces_.size());
+    const auto scale = static_cast<double>(1u << word_bits);
+    std::vector<double> result(faces_.size(), 0.0);
+    for (std::size_t i = 0; i < faces_.size(); ++i)
+    {
+        auto keep = static_cast<double>(threshold_[i]) / scale;
+        result[i] += keep / n;
+        result[alias_[i]] += (1.0 - keep) / n;
+    }
+    return result;
+}
+
+int custom_die::face_for(std::uint32_t word) const
+{
+    // The high part of word * n picks a column uniformly; the low part is an independent fraction for the coin flip
+    auto product = static_cast<std::uint64_t>(word) * faces_.size();
+    auto column = static_cast<std::size_t>(product >> word_bits);
+    auto fraction = static_cast<std::uint32_t>(product & word_max);
+    return fraction < threshold_[column] ? faces_[column] : faces_[alias_[column]];
+}
+
+int custom_die::sample(random_number_generator& rng) const
+{
+    return face_for(static_cast<std::uint32_t>(rng.generate(0, word_max)));
+}
+
+void custom_die::sample_many(random_number_generator& rng, int* first, std::size_t count) const
+{
+    rng.generate_many(0, word_max, first, count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        first[i] = face_for(static_cast<std::uint32_t>(first[i]));
+    }
+}
+
+//
+// custom_die_registry
+//
+
+const custom_die& custom_die_registry::add(const std::string& name, std::vector<int> faces,
+                                           std::vector<double> weights)
+{
+    if (name.empty() || !is_letter(name[0]) || !std::all_of(name.begin(), name.end(), is_name_char))
+    {
+        throw std::runtime_error("Invalid custom die name: " + name);
+    }
+    if (find(name))
+    {
+        throw std::runtime_error("Custom die already registered: " + name);
+    }
+
+    auto die = std::make_unique<custom_die>(std::move(faces), std::move(weights));
+    return *dice_.emplace(name, std::move(die)).first->second;
+}
+
+const custom_die* custom_die_registry::find(std::string_view name) const
+{
+    // Built in rather than added by a constructor, so an empty registry costs no allocations
+    static const custom_die fudge{ { -1, 0, 1 } };
+    if (name == "F")
+    {
+        return &fudge;
+    }
+
+    auto it = dice_.find(name);
+    return it == dice_.end() ? nullptr : it->second.get();
+}
+
+const custom_die& custom_die_registry::resolve(std::string_view definition)
+{
+    if (auto die = find(definition))
+    {
+        return *die;
+    }
+    if (auto it = inline_dice_.find(definition); it != inline_dice_.end())
+    {
+        return *it->second;
+    }
+
+    auto trimmed = trim(definition);
+    if (!trimmed.empty() && is_letter(trimmed[0]))
+    {
+        throw std::runtime_error("Unknown custom die: " + std::string(definition));
+    }
+
+    //
+    // Face list: "face[:weight], ..."
+    //
+
+    std::vector<int> faces;
+    std::vector<double> weights;
+    bool weighted = false;
+    auto rest = definition;
+    while (true)
+    {
+        auto comma = rest.find(',');
+        auto item = rest.substr(0, comma);
+
+        auto colon = item.find(':');
+        int face{ 0 };
+        double weight{ 1.0 };
+        if (!parse_number(item.substr(0, colon), face) ||
+            (colon != std::string_view::npos && !parse_number(item.substr(colon + 1), weight)))
+        {
+            throw std::runtime_error("Improper custom die faces: " + std::string(definition));
+        }
+        weighted = weighted || colon != std::string_view::npos;
+        faces.push_back(face);
+        weights.push_back(weight);
+
+        if (comma == std::string_view::npos)
+        {
+            break;
+        }
+        rest.remove_prefix(comma + 1);
+    }
+
+    if (!weighted)
+    {
+        weights.clear();
+    }
+
+    auto die = std::make_unique<custom_die>(std::move(faces), std::move(weights));
+    if (inline_dice_.size() >= max_cached_inline_dice)
+    {
+        inline_dice_.clear();
+    }
+    return *inline_dice_.emplace(std::string(definition), std::move(die)).first->second;
+}
+
+std::size_t custom_die_registry::cached_inline_dice() const
+{
+    return inline_dice_.size();
+}
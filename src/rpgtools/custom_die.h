@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "random_number_generator.h"
+
+// A die with arbitrary faces and weights, such as a Fudge die (-1, 0, +1) or d{0,0,1,1,2}. The weights are folded into
+// an alias table (Vose's method) when the die is built, so every draw costs one random word and one comparison no
+// matter how many faces the die has.
+class custom_die
+{
+public:
+    // weights may be empty for equally likely faces; otherwise it needs one positive weight per face
+    custom_die(std::vector<int> faces, std::vector<double> weights = {});
+
+    const std::vector<int>& faces() const;
+    int min_face() const;
+    int max_face() const;
+
+    // Chance of each entry of faces() coming up as sampled, read back from the alias table. The table stores each
+    // column's split as a 31-bit threshold, so these differ from the requested weights by up to about 2^-31.
+    std::vector<double> probabilities() const;
+
+    int sample(random_number_generator& rng) const;
+
+    // Fills first[0..count) with faces using a single bulk request to the generator
+    void sample_many(random_number_generator& rng, int* first, std::size_t count) const;
+
+private:
+    static const std::uint32_t word_bits = 31;
+    static const std::uint32_t word_max = (1u << word_bits) - 1;
+
+    int face_for(std::uint32_t word) const;
+
+    std::vector<int> faces_;
+    std::vector<std::uint32_t> threshold_;   // Keep column i when the word's fraction is below threshold_[i]...
+    std::vector<std::uint32_t> alias_;       // ...otherwise use face alias_[i]
+};
+
+// Named custom dice, plus a bounded cache of the inline definitions seen in expressions. The Fudge/FATE die is always
+// available as "F". Named dice are never removed, so pointers to them stay valid for the registry's lifetime.
+class custom_die_registry
+{
+public:
+    // Once this many inline definitions are cached, the cache is emptied before the next new one is added, so a
+    // long-lived registry fed arbitrary face lists doesn't grow without bound
+    static const std::size_t max_cached_inline_dice = 256;
+
+    // Names start with a letter and contain only letters, digits and underscores; re-adding a name throws
+    const custom_die& add(const std::string& name, std::vector<int> faces, std::vector<double> weights = {});
+
+    const custom_die* find(std::string_view name) const;
+
+    // Resolves the text between the braces of d{...}: either a registered name, or a face list such as "0,0,1,1,2"
+    // or, with weights, "1:3,2:1". Face lists are built once and cached; a die resolved from a face list is only
+    // guaranteed to stay valid until the next call to resolve.
+    const custom_die& resolve(std::string_view definition);
+
+    std::size_t cached_inline_dice() const;
+
+private:
+    // Lets dice_ be searched with a string_view without building a std::string
+    struct name_hash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<custom_die>, name_hash, std::equal_to<>> dice_;
+    std::unordered_map<std::string, std::unique_ptr<custom_die>, name_hash, std::equal_to<>> inline_dice_;
+};
@@ -0,0 +1,558 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "distribution_table.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// File layout (little-endian):
+//
+//   file_header
+//   entry[entry_count], sorted by (count, sides, selection_mode, selection_count)
+//   for each entry: double at_most[value_count], double at_least[value_count]
+//
+// at_most[i] is P(total <= min_value + i) and at_least[i] is P(total >= min_value + i). Both are stored so that
+// either tail can be read without cancellation error.
+//
+
+namespace
+{
+    const char file_magic[8] = { 'R', 'P', 'G', 'D', 'I', 'S', 'T', '\0' };
+    const std::uint32_t byte_order_mark = 0x01020304;
+
+    struct file_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint32_t entry_count;
+        std::uint32_t reserved;
+        std::uint64_t entries_offset;
+        std::uint64_t file_size;
+    };
+
+    const std::uint8_t mode_all = 0;
+    const std::uint8_t mode_best = 1;
+    const std::uint8_t mode_worst = 2;
+
+    std::uint8_t to_mode(expression_evaluator::dice_selection_mode mode)
+    {
+        switch (mode)
+        {
+        case expression_evaluator::dice_selection_mode::best:
+            return mode_best;
+
+        case expression_evaluator::dice_selection_mode::worst:
+            return mode_worst;
+
+        default:
+            return mode_all;
+        }
+    }
+
+    bool is_tabulated_shape(const expression_evaluator::dice_term& term)
+    {
+        return !term.exploding && !term.custom && term.count > 0 && term.count <= 0xffff && term.sides > 0 &&
+               term.sides <= 0xffff && term.selection_count >= 0 && term.selection_count <= 0xff;
+    }
+
+    struct table_entry
+    {
+        std::uint16_t count;
+        std::uint16_t sides;
+        std::uint8_t mode;
+        std::uint8_t keep;
+        std::uint16_t reserved;
+        std::int32_t min_value;
+        std::uint32_t value_count;
+        std::uint64_t data_offset;
+    };
+
+    bool operator<(const table_entry& a, const table_entry& b)
+    {
+        if (a.count != b.count)
+        {
+            return a.count < b.count;
+        }
+        if (a.sides != b.sides)
+        {
+            return a.sides < b.sides;
+        }
+        if (a.mode != b.mode)
+        {
+            return a.mode < b.mode;
+        }
+        return a.keep < b.keep;
+    }
+
+    // Lookup key for a term. Keeping at least as many dice as are rolled is the plain term, and plain terms ignore
+    // the keep count.
+    table_entry make_key(const expression_evaluator::dice_term& term)
+    {
+        table_entry key{};
+        key.count = static_cast<std::uint16_t>(term.count);
+        key.sides = static_cast<std::uint16_t>(term.sides);
+        key.mode = to_mode(term.selection_mode);
+        key.keep = static_cast<std::uint8_t>(term.selection_count);
+        if (key.mode == mode_all || term.selection_count >= term.count)
+        {
+            key.mode = mode_all;
+            key.keep = 0;
+        }
+        return key;
+    }
+
+    // Distribution of a single die as the evaluator rolls it (d66 and d666 are digit-per-die)
+    dice_distribution single_die(int sides)
+    {
+        if (sides == 66 || sides == 666)
+        {
+            auto digits = sides == 66 ? 2 : 3;
+            auto min_value = sides == 66 ? 11 : 111;
+            dice_distribution result{ min_value, std::vector<double>(sides - min_value + 1, 0.0) };
+            auto cells = digits == 2 ? 36 : 216;
+            for (int cell = 0; cell < cells; ++cell)
+            {
+                int value = 0;
+                for (int d = 0, rest = cell; d < digits; ++d, rest /= 6)
+                {
+                    value = value * 10 + rest % 6 + 1;
+                }
+                result.probabilities[value - min_value] += 1.0 / cells;
+            }
+            return result;
+        }
+
+        return { 1, std::vector<double>(sides, 1.0 / sides) };
+    }
+
+    // Keep the best (or worst) k of n dM. Faces are visited from the kept end; the first k dice placed are the kept
+    // ones. dp[placed][kept_sum] carries the multinomial weight of every arrangement seen so far.
+    dice_distribution keep_distribution(int n, int sides, int k, bool best)
+    {
+        const double p = 1.0 / sides;
+        std::vector<double> binomial((n + 1) * (n + 1), 0.0);
+        for (int i = 0; i <= n; ++i)
+        {
+            binomial[i * (n + 1)] = 1.0;
+            for (int j = 1; j <= i; ++j)
+            {
+                binomial[i * (n + 1) + j] = binomial[(i - 1) * (n + 1) + j - 1] + binomial[(i - 1) * (n + 1) + j];
+            }
+        }
+
+        const int max_sum = k * sides;
+        std::vector<std::vector<double>> dp(n + 1, std::vector<double>(max_sum + 1, 0.0));
+        dp[0][0] = 1.0;
+
+        for (int step = 0; step < sides; ++step)
+        {
+            const int face = best ? sides - step : step + 1;
+            std::vector<std::vector<double>> next(n + 1, std::vector<double>(max_sum + 1, 0.0));
+            for (int placed = 0; placed <= n; ++placed)
+            {
+                for (int sum = 0; sum <= max_sum; ++sum)
+                {
+                    auto weight = dp[placed][sum];
+                    if (weight == 0.0)
+                    {
+                        continue;
+                    }
+
+                    double p_power = 1.0;
+                    for (int c = 0; placed + c <= n; ++c, p_power *= p)
+                    {
+                        auto kept = std::max(0, std::min(c, k - placed));
+                        next[placed + c][sum + kept * face] +=
+                            weight * binomial[(n - placed) * (n + 1) + c] * p_power;
+                    }
+                }
+            }
+            dp = std::move(next);
+        }
+
+        return { k, std::vector<double>(dp[n].begin() + k, dp[n].end()) };
+    }
+
+    void write_bytes(std::ofstream& out, const void* data, std::size_t size)
+    {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+}
+
+dice_distribution convolve(const dice_distribution& a, const dice_distribution& b)
+{
+    dice_distribution result{ a.min_value + b.min_value,
+                              std::vector<double>(a.probabilities.size() + b.probabilities.size() - 1, 0.0) };
+    for (std::size_t i = 0; i < a.probabilities.size(); ++i)
+    {
+        for (std::size_t j = 0; j < b.probabilities.size(); ++j)
+        {
+            result.probabilities[i + j] += a.probabilities[i] * b.probabilities[j];
+        }
+    }
+    return result;
+}
+
+dice_distribution compute_distribution(const expression_evaluator::dice_term& term)
+{
+    if (!is_tabulated_shape(term))
+    {
+        throw std::runtime_error("Distribution not available for this dice term");
+    }
+
+    auto key = make_key(term);
+    auto special = term.sides == 66 || term.sides == 666;
+    if (key.mode != mode_all)
+    {
+        if (special || key.keep == 0)
+        {
+            throw std::runtime_error("Distribution not available for this dice term");
+        }
+        return keep_distribution(term.count, term.sides, key.keep, key.mode == mode_best);
+    }
+
+    auto die = single_die(term.sides);
+    auto result = die;
+    for (int i = 1; i < term.count; ++i)
+    {
+        result = convolve(result, die);
+    }
+    return result;
+}
+
+std::vector<expression_evaluator::dice_term> standard_distribution_terms()
+{
+    using mode = expression_evaluator::dice_selection_mode;
+    const int standard_sides[] = { 2, 3, 4, 6, 8, 10, 12, 20, 100 };
+
+    std::vector<expression_evaluator::dice_term> terms;
+    for (auto sides : standard_sides)
+    {
+        for (int count = 1; count <= 100; ++count)
+        {
+            terms.push_back({ count, sides, false, mode::all, 0 });
+        }
+        for (int count = 2; count <= 8; ++count)
+        {
+            for (int keep = 1; keep < count; ++keep)
+            {
+                terms.push_back({ count, sides, false, mode::best, keep });
+                terms.push_back({ count, sides, false, mode::worst, keep });
+            }
+        }
+    }
+    terms.push_back({ 1, 66, false, mode::all, 0 });
+    terms.push_back({ 1, 666, false, mode::all, 0 });
+    return terms;
+}
+
+void write_distribution_table(const std::string& path, const std::vector<expression_evaluator::dice_term>& terms)
+{
+    // Sort and de-duplicate by key so readers can binary search
+    std::vector<std::pair<table_entry, expression_evaluator::dice_term>> keyed;
+    for (const auto& term : terms)
+    {
+        if (!is_tabulated_shape(term))
+        {
+            throw std::runtime_error("Distribution not available for this dice term");
+        }
+        keyed.emplace_back(make_key(term), term);
+    }
+    std::sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    keyed.erase(std::unique(keyed.begin(), keyed.end(),
+                            [](const auto& a, const auto& b) { return !(a.first < b.first) && !(b.first < a.first); }),
+                keyed.end());
+
+    std::vector<table_entry> entries;
+    std::vector<std::vector<double>> tables;
+    std::uint64_t offset = sizeof(file_header) + keyed.size() * sizeof(table_entry);
+
+    for (const auto& item : keyed)
+    {
+        auto distribution = compute_distribution(item.second);
+        const auto value_count = distribution.probabilities.size();
+
+        std::vector<double> table(value_count * 2);
+        double running = 0.0;
+        for (std::size_t i = 0; i < value_count; ++i)
+        {
+            running += distribution.probabilities[i];
+            table[i] = running;
+        }
+        running = 0.0;
+        for (std::size_t i = value_count; i-- > 0;)
+        {
+            running += distribution.probabilities[i];
+            table[value_count + i] = running;
+        }
+        table[value_count - 1] = 1.0;   // Absorb rounding so inverse-CDF lookups always land on a value
+        table[value_count] = 1.0;
+
+        auto e = item.first;
+        e.min_value = distribution.min_value;
+        e.value_count = static_cast<std::uint32_t>(value_count);
+        e.data_offset = offset;
+        offset += table.size() * sizeof(double);
+
+        entries.push_back(e);
+        tables.push_back(std::move(table));
+    }
+
+    file_header header{};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.version = distribution_table::format_version;
+    header.byte_order = byte_order_mark;
+    header.entry_count = static_cast<std::uint32_t>(entries.size());
+    header.entries_offset = sizeof(file_header);
+    header.file_size = offset;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Unable to create distribution table: " + path);
+    }
+
+    write_bytes(out, &header, sizeof(header));
+    write_bytes(out, entries.data(), entries.size() * sizeof(table_entry));
+    for (const auto& table : tables)
+    {
+        write_bytes(out, table.data(), table.size() * sizeof(double));
+    }
+
+    if (!out)
+    {
+        throw std::runtime_error("Unable to write distribution table: " + path);
+    }
+}
+
+distribution_table::distribution_table(const std::string& path)
+{
+#ifdef _WIN32
+    auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Unable to open distribution table: " + path);
+    }
+    file_ = file;
+
+    LARGE_INTEGER file_size{};
+    GetFileSizeEx(file, &file_size);
+    size_ = static_cast<std::size_t>(file_size.QuadPart);
+    mapping_ = size_ ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    data_ = mapping_ ? static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!data_)
+    {
+        unmap();
+        throw std::runtime_error("Unable to map distribution table: " + path);
+    }
+#else
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Unable to open distribution table: " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to map distribution table: " + path);
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    auto mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map distribution table: " + path);
+    }
+    data_ = static_cast<const unsigned char*>(mapped);
+#endif
+
+    file_header header{};
+    if (size_ >= sizeof(header))
+    {
+        std::memcpy(&header, data_, sizeof(header));
+    }
+
+    std::string error;
+    if (size_ < sizeof(header))
+    {
+        error = "Distribution table is truncated: ";
+    }
+    else if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 || header.byte_order != byte_order_mark)
+    {
+        error = "Not a distribution table: ";
+    }
+    else if (header.version != format_version)
+    {
+        error = "Unsupported distribution table version " + std::to_string(header.version) + ": ";
+    }
+    else if (header.file_size != size_ || header.entries_offset > size_ ||
+             header.entry_count > (size_ - header.entries_offset) / sizeof(table_entry))
+    {
+        error = "Distribution table is truncated: ";
+    }
+    else if (header.entries_offset < sizeof(header) || header.entries_offset % alignof(table_entry) != 0)
+    {
+        error = "Distribution table is corrupt: ";
+    }
+    else
+    {
+        // Entries are read in place, so each one's tables must be aligned and inside the file, and lookups binary
+        // search them, so they must be strictly sorted. Sizes are compared by division to rule out overflow.
+        auto entries = reinterpret_cast<const table_entry*>(data_ + header.entries_offset);
+        for (std::size_t i = 0; i < header.entry_count; ++i)
+        {
+            const auto& entry = entries[i];
+            if (entry.value_count == 0 || entry.data_offset % alignof(double) != 0 || entry.data_offset > size_ ||
+                entry.value_count > (size_ - entry.data_offset) / (2 * sizeof(double)) ||
+                (i > 0 && !(entries[i - 1] < entry)))
+            {
+                error = "Distribution table is corrupt: ";
+                break;
+            }
+        }
+    }
+
+    if (!error.empty())
+    {
+        unmap();
+        throw std::runtime_error(error + path);
+    }
+
+    entries_offset_ = static_cast<std::size_t>(header.entries_offset);
+    entry_count_ = header.entry_count;
+}
+
+distribution_table::~distribution_table()
+{
+    unmap();
+}
+
+void distribution_table::unmap()
+{
+#ifdef _WIN32
+    if (data_)
+    {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_)
+    {
+        CloseHandle(mapping_);
+    }
+    if (file_)
+    {
+        CloseHandle(file_);
+    }
+    file_ = nullptr;
+    mapping_ = nullptr;
+#else
+    if (data_)
+    {
+        munmap(const_cast<unsigned char*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    entry_count_ = 0;
+}
+
+std::size_t distribution_table::size() const
+{
+    return entry_count_;
+}
+
+bool distribution_table::find(const expression_evaluator::dice_term& term, term_view& view) const
+{
+    if (!is_tabulated_shape(term))
+    {
+        return false;
+    }
+
+    auto key = make_key(term);
+    auto first = reinterpret_cast<const table_entry*>(data_ + entries_offset_);
+    auto last = first + entry_count_;
+    auto it = std::lower_bound(first, last, key);
+    if (it == last || key < *it)
+    {
+        return false;
+    }
+
+    view.min_value = it->min_value;
+    view.value_count = it->value_count;
+    view.at_most = reinterpret_cast<const double*>(data_ + it->data_offset);
+    view.at_least = view.at_most + it->value_count;
+    return true;
+}
+
+distribution_table::term_view distribution_table::get(const expression_evaluator::dice_term& term) const
+{
+    term_view view;
+    if (!find(term, view))
+    {
+        throw std::runtime_error("Dice term not in distribution table");
+    }
+    return view;
+}
+
+bool distribution_table::contains(const expression_evaluator::dice_term& term) const
+{
+    term_view view;
+    return find(term, view);
+}
+
+double distribution_table::probability_at_least(const expression_evaluator::dice_term& term, int target) const
+{
+    auto view = get(term);
+    auto index = static_cast<long long>(target) - view.min_value;
+    if (index <= 0)
+    {
+        return 1.0;
+    }
+    if (index >= view.value_count)
+    {
+        return 0.0;
+    }
+    return view.at_least[index];
+}
+
+double distribution_table::probability_at_most(const expression_evaluator::dice_term& term, int target) const
+{
+    auto view = get(term);
+    auto index = static_cast<long long>(target) - view.min_value;
+    if (index < 0)
+    {
+        return 0.0;
+    }
+    if (index >= view.value_count)
+    {
+        return 1.0;
+    }
+    return view.at_most[index];
+}
+
+int distribution_table::sample(const expression_evaluator::dice_term& term, random_number_generator& rng) const
+{
+    auto view = get(term);
+
+    // Build a 60-bit uniform from two draws; generate() only hands out ints
+    const int draw_max = (1 << 30) - 1;
+    auto high = static_cast<std::uint64_t>(rng.generate(0, draw_max));
+    auto low = static_cast<std::uint64_t>(rng.generate(0, draw_max));
+    auto u = static_cast<double>((high << 30) | low) / static_cast<double>(1ull << 60);
+
+    auto it = std::upper_bound(view.at_most, view.at_most + view.value_count, u);
+    auto index = std::min<std::size_t>(it - view.at_most, view.value_count - 1);
+    return view.min_value + static_cast<int>(index);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "expression_evaluator.h"
+#include "random_number_generator.h"
+
+// Exact probability distribution of a single dice term's total
+struct dice_distribution
+{
+    int min_value;
+    std::vector<double> probabilities;   // probabilities[i] is P(total == min_value + i)
+};
+
+// Distribution of the sum of two independent totals
+dice_distribution convolve(const dice_distribution& a, const dice_distribution& b);
+
+// Computes the exact distribution of a non-exploding term: plain NdM, NdM keep best/worst, d66 and d666
+dice_distribution compute_distribution(const expression_evaluator::dice_term& term);
+
+// The terms written by default: NdM for N <= 100 over the standard die set, keep best/worst variants for N <= 8,
+// and d66/d666
+std::vector<expression_evaluator::dice_term> standard_distribution_terms();
+
+// Writes a versioned table of cumulative distributions for the given terms
+void write_distribution_table(const std::string& path, const std::vector<expression_evaluator::dice_term>& terms);
+
+// Read-only, memory-mapped view of a file produced by write_distribution_table. The pages are shared by every
+// process that maps the same file. Opening validates the header and walks the entry table once, checking ordering,
+// alignment and offsets; queries then read the mapping directly without copying it.
+class distribution_table
+{
+public:
+    static const std::uint32_t format_version = 1;
+
+    explicit distribution_table(const std::string& path);
+    ~distribution_table();
+
+    distribution_table(const distribution_table&) = delete;
+    distribution_table& operator=(const distribution_table&) = delete;
+
+    std::size_t size() const;
+    bool contains(const expression_evaluator::dice_term& term) const;
+
+    // P(total >= target); throws if the term is not in the table
+    double probability_at_least(const expression_evaluator::dice_term& term, int target) const;
+
+    // P(total <= target); throws if the term is not in the table
+    double probability_at_most(const expression_evaluator::dice_term& term, int target) const;
+
+    // Samples the term's total with one inverse-CDF lookup; throws if the term is not in the table
+    int sample(const expression_evaluator::dice_term& term, random_number_generator& rng) const;
+
+private:
+    // One term's tables, pointing into the mapped file
+    struct term_view
+    {
+        int min_value;
+        std::uint32_t value_count;
+        const double* at_most;    // at_most[i] is P(total <= min_value + i)
+        const double* at_least;   // at_least[i] is P(total >= min_value + i)
+    };
+
+    bool find(const expression_evaluator::dice_term& term, term_view& view) const;
+    term_view get(const expression_evaluator::dice_term& term) const;
+    void unmap();
+
+    const unsigned char* data_{ nullptr };
+    std::size_t size_{ 0 };
+    std::size_t entries_offset_{ 0 };
+    std::size_t entry_count_{ 0 };
+#ifdef _WIN32
+    void* file_{ nullptr };
+    void* mapping_{ nullptr };
+#endif
+};
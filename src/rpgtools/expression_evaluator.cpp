@@ -1,51 +1,250 @@
 #include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <numeric>
-#include <sstream>
-#include <iterator>
 #include <stdexcept>
 #include "expression_evaluator.h"
+#include "distribution_table.h"
 
-expression_evaluator::expression_evaluator(random_number_generator* rng) : rng_{ rng }
+namespace
 {
+    bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    int to_int(std::string_view digits)
+    {
+        int value{ 0 };
+        auto result = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (result.ec != std::errc{} || result.ptr != digits.data() + digits.size())
+        {
+            throw std::runtime_error("Number out of range: " + std::string(digits));
+        }
+        return value;
+    }
+
+    bool is_comparison(std::string_view token)
+    {
+        return token == ">=" || token == ">" || token == "<=" || token == "<" || token == "=";
+    }
+
+    bool compare(int total, int target, std::string_view comparison)
+    {
+        switch (comparison[0])
+        {
+        case '>':
+            return comparison.size() > 1 ? total >= target : total > target;
+
+        case '<':
+            return comparison.size() > 1 ? total <= target : total < target;
+
+        case '=':
+            return total == target;
+
+        default:
+            throw std::runtime_error("Unexpected operator: " + std::string(comparison));
+        }
+    }
+
+    void append_number(std::string& out, int value)
+    {
+        char buffer[16];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+
+    // One die as rolled: its total plus the run of faces (more than one when it exploded) in the face list
+    struct die_roll
+    {
+        int total;
+        std::size_t first_face;
+        std::size_t face_count;
+    };
+
+    void append_die(std::string& out, const die_roll& roll, const std::pmr::vector<int>& faces, bool is_exploding)
+    {
+        if (is_exploding && roll.face_count > 1)
+        {
+            // Show exploding dice as [roll1+roll2+...]
+            out += '[';
+            for (std::size_t j = 0; j < roll.face_count; ++j)
+            {
+                if (j > 0)
+                {
+                    out += '+';
+                }
+                append_number(out, faces[roll.first_face + j]);
+            }
+            out += ']';
+        }
+        else
+        {
+            append_number(out, roll.total);
+        }
+    }
 }
 
-int expression_evaluator::get_precedence(const std::string& op)
+expression_evaluator::expression_evaluator(random_number_generator* rng, std::pmr::memory_resource* upstream)
+    : rng_{ rng }, pool_{ upstream }
+{
+}
+
+void expression_evaluator::set_distribution_table(const distribution_table* table)
+{
+    distributions_ = table;
+}
+
+void expression_evaluator::set_totals_only(bool enabled)
+{
+    totals_only_ = enabled;
+}
+
+custom_die_registry& expression_evaluator::custom_dice()
+{
+    return custom_dice_;
+}
+
+int expression_evaluator::get_precedence(std::string_view op)
 {
     auto it = operators.find(op);
     if (it == operators.end())
     {
-        throw std::runtime_error("Unknown operator precedence: " + op);
+        throw std::runtime_error("Unknown operator precedence: " + std::string(op));
     }
     return it->second.precedence;
 }
-expression_evaluator::assocativity expression_evaluator::get_associativity(const std::string& op)
+expression_evaluator::assocativity expression_evaluator::get_associativity(std::string_view op)
 {
     auto it = operators.find(op);
     if (it == operators.end())
     {
-        throw std::runtime_error("Unknown operator associativity: " + op);
+        throw std::runtime_error("Unknown operator associativity: " + std::string(op));
     }
     return it->second.associativity;
 }
 
-int expression_evaluator::evaluate(const std::string expression, std::string* description)
+int expression_evaluator::evaluate(std::string_view expression, std::string* description,
+                                   std::vector<die_result>* dice)
 {
-    std::stack<int> stack;
-    std::vector<std::string> rolls;
+    token_list tokens{ &pool_ };
+    token_list prefix{ &pool_ };
 
-    auto tokens = parse(expression);
-    auto prefix = convert_infix_to_prefix(tokens);
+    parse(expression, tokens);
+    convert_infix_to_prefix(tokens, prefix);
 
-    for (const auto& token : prefix)
+    return evaluate_prefix(prefix, description, dice);
+}
+
+expression_evaluator::check_result expression_evaluator::evaluate_check(std::string_view expression,
+                                                                       std::string* description,
+                                                                       std::vector<die_result>* dice)
+{
+    token_list tokens{ &pool_ };
+    token_list prefix{ &pool_ };
+
+    parse(expression, tokens);
+    convert_infix_to_prefix(tokens, prefix);
+    if (prefix.empty() || !is_comparison(prefix.back()))
+    {
+        throw std::runtime_error("Not a target number check: " + std::string(expression));
+    }
+
+    // Stop short of the comparison to keep both of its sides
+    std::pmr::vector<int> stack{ &pool_ };
+    evaluate_tokens(prefix.begin(), prefix.end() - 1, stack, description, dice);
+    if (stack.size() != 2)
+    {
+        throw std::runtime_error("Parse error");
+    }
+
+    const auto& comparison = prefix.back();
+    check_result result{ stack[0], stack[1], compare(stack[0], stack[1], comparison), 0 };
+    result.margin = comparison[0] == '<' ? result.target - result.total : result.total - result.target;
+    return result;
+}
+
+bool expression_evaluator::is_check(std::string_view expression)
+{
+    token_list tokens{ &pool_ };
+    token_list prefix{ &pool_ };
+
+    parse(expression, tokens);
+    convert_infix_to_prefix(tokens, prefix);
+    return !prefix.empty() && is_comparison(prefix.back());
+}
+
+int expression_evaluator::evaluate_prefix(const std::vector<std::string>& prefix, std::string* description,
+                                          std::vector<die_result>* dice)
+{
+    token_list tokens{ prefix.begin(), prefix.end(), &pool_ };
+    return evaluate_prefix(tokens, description, dice);
+}
+
+int expression_evaluator::evaluate_prefix(const token_list& prefix, std::string* description,
+                                          std::vector<die_result>* dice)
+{
+    std::pmr::vector<int> stack{ &pool_ };
+    evaluate_tokens(prefix.begin(), prefix.end(), stack, description, dice);
+
+    if (stack.size() != 1)
     {
+        throw std::runtime_error("Parse error");
+    }
+
+    return stack.back();
+}
+
+void expression_evaluator::evaluate_tokens(token_list::const_iterator first, token_list::const_iterator last,
+                                           std::pmr::vector<int>& stack, std::string* description,
+                                           std::vector<die_result>* dice)
+{
+    int term_index{ 0 };
+
+    if (description)
+    {
+        description->clear();
+    }
+    if (dice)
+    {
+        dice->clear();
+    }
+
+    for (auto it = first; it != last; ++it)
+    {
+        const auto& token = *it;
         switch (get_token_type(token))
         {
         case token_type::number:
-            stack.push(std::stoi(token));
+            stack.push_back(to_int(token));
             break;
 
         case token_type::dice_expression:
-            stack.push(evaluate_dice_expression(token, rolls));
+            if (!description && !dice && distributions_)
+            {
+                auto term = parse_dice_expression(token);
+                if (distributions_->contains(term))
+                {
+                    stack.push_back(distributions_->sample(term, *rng_));
+                    break;
+                }
+            }
+            if (description && !description->empty())
+            {
+                *description += ' ';
+            }
+            {
+                auto first_die = dice ? dice->size() : 0;
+                stack.push_back(evaluate_dice_expression(token, description, dice));
+                for (auto i = first_die; dice && i < dice->size(); ++i)
+                {
+                    (*dice)[i].term = term_index;
+                }
+                ++term_index;
+            }
             break;
 
         case token_type::operation:
@@ -53,110 +252,430 @@ int expression_evaluator::evaluate(const std::string expression, std::string* de
             break;
 
         default:
-            throw std::runtime_error("Unexpected token: " + token);
+            throw std::runtime_error("Unexpected token: " + std::string(token));
+        }
+    }
+}
+
+void expression_evaluator::evaluate_many(const token_list& prefix, std::size_t count, int* results)
+{
+    //
+    // Decode the prefix once, checking operands as evaluate_prefix would
+    //
+
+    struct step
+    {
+        token_type type;
+        int number;
+        std::size_t term;   // Which dice term this is, counting from 0
+        std::string_view token;
+    };
+
+    std::pmr::vector<step> steps{ &pool_ };
+    std::size_t terms{ 0 };
+    std::size_t dice_per_repetition{ 0 };
+    std::size_t depth{ 0 };
+    steps.reserve(prefix.size());
+
+    for (const auto& token : prefix)
+    {
+        auto type = get_token_type(token);
+        switch (type)
+        {
+        case token_type::number:
+            steps.push_back({ type, to_int(token), 0, token });
+            ++depth;
+            break;
+
+        case token_type::dice_expression: {
+            // Only the dice count is kept: a custom die's definition may not outlive the next inline die resolved
+            auto term = parse_dice_expression(token);
+            dice_per_repetition += std::max(term.count, 1);
+            steps.push_back({ type, 0, terms++, token });
+            ++depth;
+        }
+        break;
+
+        case token_type::operation:
+            if (depth < 2)
+            {
+                throw std::runtime_error("Missing operand for operator: " + std::string(token));
+            }
+            steps.push_back({ type, 0, 0, token });
+            --depth;
+            break;
+
+        default:
+            throw std::runtime_error("Unexpected token: " + std::string(token));
         }
     }
 
-    if (stack.size() > 1)
+    if (depth != 1)
     {
         throw std::runtime_error("Parse error");
     }
 
-    if (description)
+    //
+    // Work through the repetitions in batches of about max_batch_dice dice, so scratch memory stays bounded
+    // whatever the count. Each batch rolls every dice term for all of its repetitions up front, then runs the
+    // arithmetic for each repetition.
+    //
+
+    const auto batch_size = std::max<std::size_t>(max_batch_dice / std::max<std::size_t>(dice_per_repetition, 1), 1);
+    std::pmr::vector<int> term_totals{ &pool_ };   // batch totals for each dice term, one term after another
+    std::pmr::vector<int> stack{ &pool_ };
+    stack.reserve(steps.size());
+
+    for (std::size_t first = 0; first < count; first += batch_size)
     {
-        std::stringstream result{};
-        std::copy(rolls.begin(), rolls.end(), std::ostream_iterator<std::string>(result, " "));
-        *description = result.str();
-        if (!rolls.empty())
+        const auto batch = std::min(batch_size, count - first);
+        term_totals.resize(terms * batch);
+        for (const auto& s : steps)
         {
-            (*description).pop_back();
+            if (s.type == token_type::dice_expression)
+            {
+                roll_term_many(parse_dice_expression(s.token), batch, term_totals.data() + s.term * batch);
+            }
         }
-    }
 
-    return stack.top();
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            stack.clear();
+            for (const auto& s : steps)
+            {
+                switch (s.type)
+                {
+                case token_type::number:
+                    stack.push_back(s.number);
+                    break;
+
+                case token_type::dice_expression:
+                    stack.push_back(term_totals[s.term * batch + i]);
+                    break;
+
+                default:
+                    evaluate_operation(stack, s.token);
+                    break;
+                }
+            }
+            results[first + i] = stack.back();
+        }
+    }
 }
 
-int expression_evaluator::evaluate_dice_expression(const std::string& token, std::vector<std::string>& rolls)
+void expression_evaluator::roll_term_many(const dice_term& term, std::size_t count, int* totals)
 {
-    const std::regex expr{ "(\\d*)[dD](\\d+)(!)?(([bBwW])(\\d*))?" };
-    std::smatch match;
-    if (!std::regex_match(token, match, expr))
+    if (distributions_ && distributions_->contains(term))
     {
-        throw std::runtime_error("Improper dice expression: " + token);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            totals[i] = distributions_->sample(term, *rng_);
+        }
+        return;
     }
 
-    auto num_rolls = match[1].str().empty() ? 1 : std::stoi(match[1].str());
-    auto dice_size = std::stoi(match[2].str());
-    auto is_exploding = !match[3].str().empty();
-    auto selection_mode = get_keeping_mode(match[5].str());
-    auto selection_count = match[6].str().empty() ? 0 : std::stoi(match[6].str());
+    // d66 and d666 read several dice per face, and exploding dice roll until they stop; without totals-only mode,
+    // they are rolled one repetition at a time
+    if (!term.custom && (term.sides == 66 || term.sides == 666 || (term.exploding && !totals_only_)))
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            totals[i] = evaluate_dice_expression(term, nullptr);
+        }
+        return;
+    }
 
     //
-    // Roll the dice
+    // Every die of every repetition comes from one bulk draw
+    //
+
+    auto dice_per_roll = static_cast<std::size_t>(term.count);
+    if (dice_per_roll > 0 && count > static_cast<std::size_t>(std::numeric_limits<int>::max()) / dice_per_roll)
+    {
+        throw std::runtime_error("Too many dice in one batch: " + std::to_string(count) + " rolls of " +
+                                 std::to_string(dice_per_roll));
+    }
+
+    std::pmr::vector<int> faces{ &pool_ };
+    if (term.custom)
+    {
+        faces.resize(count * dice_per_roll);
+        term.custom->sample_many(*rng_, faces.data(), faces.size());
+    }
+    else if (term.exploding)
+    {
+        roll_exploding_totals(static_cast<int>(count * dice_per_roll), term.sides, faces);
+    }
+    else
+    {
+        faces.resize(count * dice_per_roll);
+        rng_->generate_many(1, term.sides, faces.data(), faces.size());
+    }
+
+    //
+    // Keep the best or worst of each repetition's dice; nth_element partitions them without a full sort
     //
 
-    std::vector<int> dice_rolls;
-    std::vector<std::vector<int>> exploded_rolls; // To track individual explosions for description
-    
-    for (auto i = 0; i < num_rolls; ++i)
+    auto keep = std::min(dice_per_roll, static_cast<std::size_t>(term.selection_count));
+    auto selection_mode = keep < dice_per_roll ? term.selection_mode : dice_selection_mode::all;
+
+    for (std::size_t i = 0; i < count; ++i)
     {
-        std::vector<int> individual_exploded_rolls;
-        int total_result{ 0 };
-        
-        switch (dice_size)
+        auto first = faces.begin() + static_cast<std::ptrdiff_t>(i * dice_per_roll);
+        auto last = first + static_cast<std::ptrdiff_t>(dice_per_roll);
+
+        switch (selection_mode)
         {
-        case 666:
-            {
-                int result = rng_->generate(1, 6) * 100;
-                result += rng_->generate(1, 6) * 10;
-                result += rng_->generate(1, 6);
-                total_result = result;
-                individual_exploded_rolls.push_back(result);
-                // Note: Exploding dice logic doesn't apply to special dice like d666/d66
-            }
+        case dice_selection_mode::all:
             break;
 
-        case 66:
-            {
-                int result = rng_->generate(1, 6) * 10;
-                result += rng_->generate(1, 6);
-                total_result = result;
-                individual_exploded_rolls.push_back(result);
-                // Note: Exploding dice logic doesn't apply to special dice like d666/d66
-            }
+        case dice_selection_mode::best:
+            std::nth_element(first, last - static_cast<std::ptrdiff_t>(keep), last);
+            first = last - static_cast<std::ptrdiff_t>(keep);
+            break;
+
+        case dice_selection_mode::worst:
+            std::nth_element(first, first + static_cast<std::ptrdiff_t>(keep), last);
+            last = first + static_cast<std::ptrdiff_t>(keep);
             break;
 
         default:
+            throw std::runtime_error("Invalid dice modifier");
+        }
+
+        totals[i] = std::accumulate(first, last, 0);
+    }
+}
+
+bool expression_evaluator::parse_repetition(std::string_view expression, std::size_t& count, std::string_view& inner)
+{
+    // [count] (x|X) [expression], with spaces allowed around the x
+    auto pos = std::min(expression.find_first_not_of(' '), expression.size());
+    auto start = pos;
+    while (pos < expression.size() && is_digit(expression[pos]))
+    {
+        ++pos;
+    }
+    auto digits = expression.substr(start, pos - start);
+
+    pos = std::min(expression.find_first_not_of(' ', pos), expression.size());
+    if (digits.empty() || pos == expression.size() || (expression[pos] != 'x' && expression[pos] != 'X'))
+    {
+        return false;
+    }
+
+    auto repetitions = static_cast<std::size_t>(to_int(digits));
+    if (repetitions > max_repetitions)
+    {
+        throw std::runtime_error("Too many repetitions: " + std::string(digits) + " (at most " +
+                                 std::to_string(max_repetitions) + ")");
+    }
+
+    count = repetitions;
+    inner = expression.substr(pos + 1);
+    return true;
+}
+
+long long expression_evaluator::evaluate_repeated(std::string_view expression, std::vector<int>& results, bool sorted)
+{
+    std::size_t count{ 1 };
+    auto inner = expression;
+    parse_repetition(expression, count, inner);
+
+    token_list tokens{ &pool_ };
+    token_list prefix{ &pool_ };
+    parse(inner, tokens);
+    convert_infix_to_prefix(tokens, prefix);
+
+    results.resize(count);
+    evaluate_many(prefix, count, results.data());
+
+    if (sorted)
+    {
+        std::sort(results.begin(), results.end(), std::greater<>{});
+    }
+    return std::accumulate(results.begin(), results.end(), 0LL);
+}
+
+expression_evaluator::dice_term expression_evaluator::parse_dice_expression(std::string_view token)
+{
+    // [count] (d|D) (sides | F | {faces or name}) [!] [(b|B|w|W) [keep]]
+    std::size_t pos = 0;
+    auto read_digits = [&]() {
+        auto start = pos;
+        while (pos < token.size() && is_digit(token[pos]))
+        {
+            ++pos;
+        }
+        return token.substr(start, pos - start);
+    };
+    auto improper = [&]() { return std::runtime_error("Improper dice expression: " + std::string(token)); };
+
+    auto count = read_digits();
+    if (pos == token.size() || (token[pos] != 'd' && token[pos] != 'D'))
+    {
+        throw improper();
+    }
+    ++pos;
+
+    dice_term term;
+    std::string_view sides;
+    if (pos < token.size() && token[pos] == 'F')
+    {
+        term.custom = custom_dice_.find("F");
+        ++pos;
+    }
+    else if (pos < token.size() && token[pos] == '{')
+    {
+        auto close = token.find('}', pos);
+        if (close == std::string_view::npos)
+        {
+            throw improper();
+        }
+        term.custom = &custom_dice_.resolve(token.substr(pos + 1, close - pos - 1));
+        pos = close + 1;
+    }
+    else
+    {
+        sides = read_digits();
+        if (sides.empty())
+        {
+            throw improper();
+        }
+    }
+
+    term.exploding = pos < token.size() && token[pos] == '!';
+    if (term.exploding)
+    {
+        if (term.custom)
+        {
+            throw std::runtime_error("Custom dice can't explode: " + std::string(token));
+        }
+        ++pos;
+    }
+
+    std::string_view mode;
+    std::string_view keep;
+    if (pos < token.size() && std::string_view{ "bBwW" }.find(token[pos]) != std::string_view::npos)
+    {
+        mode = token.substr(pos++, 1);
+        keep = read_digits();
+    }
+
+    if (pos != token.size())
+    {
+        throw improper();
+    }
+
+    term.count = count.empty() ? 1 : to_int(count);
+    term.sides = term.custom ? static_cast<int>(term.custom->faces().size()) : to_int(sides);
+    term.selection_mode = get_keeping_mode(mode);
+    term.selection_count = keep.empty() ? 0 : to_int(keep);
+    return term;
+}
+
+int expression_evaluator::evaluate_dice_expression(std::string_view token, std::string* description,
+                                                   std::vector<die_result>* dice)
+{
+    return evaluate_dice_expression(parse_dice_expression(token), description, dice);
+}
+
+int expression_evaluator::evaluate_dice_expression(const dice_term& term, std::string* description,
+                                                   std::vector<die_result>* dice)
+{
+    auto num_rolls = term.count;
+    auto dice_size = term.sides;
+    auto is_exploding = term.exploding;
+    auto selection_mode = term.selection_mode;
+    auto selection_count = static_cast<std::size_t>(term.selection_count);
+
+    //
+    // Roll the dice
+    //
+
+    std::pmr::vector<die_roll> dice_rolls{ &pool_ };
+    std::pmr::vector<int> faces{ &pool_ };   // Every face rolled, so explosions can be described
+    dice_rolls.reserve(num_rolls);
+
+    if (term.custom)
+    {
+        // Custom faces come from one bulk draw through the die's alias table
+        faces.resize(num_rolls);
+        term.custom->sample_many(*rng_, faces.data(), faces.size());
+        for (std::size_t i = 0; i < faces.size(); ++i)
+        {
+            dice_rolls.push_back({ faces[i], i, 1 });
+        }
+    }
+    else if (is_exploding && totals_only_ && !description && !dice && dice_size != 66 && dice_size != 666)
+    {
+        roll_exploding_totals(num_rolls, dice_size, faces);
+        for (std::size_t i = 0; i < faces.size(); ++i)
+        {
+            dice_rolls.push_back({ faces[i], i, 1 });
+        }
+    }
+    else
+    {
+        for (auto i = 0; i < num_rolls; ++i)
+        {
+            die_roll roll{ 0, faces.size(), 0 };
+
+            switch (dice_size)
             {
-                int roll = rng_->generate(1, dice_size);
-                total_result = roll;
-                individual_exploded_rolls.push_back(roll);
-                
-                // Handle exploding dice
-                if (is_exploding)
+            case 666:
+                {
+                    int result = rng_->generate(1, 6) * 100;
+                    result += rng_->generate(1, 6) * 10;
+                    result += rng_->generate(1, 6);
+                    roll.total = result;
+                    faces.push_back(result);
+                    // Note: Exploding dice logic doesn't apply to special dice like d666/d66
+                }
+                break;
+
+            case 66:
                 {
-                    while (roll == dice_size)
+                    int result = rng_->generate(1, 6) * 10;
+                    result += rng_->generate(1, 6);
+                    roll.total = result;
+                    faces.push_back(result);
+                    // Note: Exploding dice logic doesn't apply to special dice like d666/d66
+                }
+                break;
+
+            default:
+                {
+                    int face = rng_->generate(1, dice_size);
+                    roll.total = face;
+                    faces.push_back(face);
+
+                    // Handle exploding dice
+                    if (is_exploding)
                     {
-                        roll = rng_->generate(1, dice_size);
-                        total_result += roll;
-                        individual_exploded_rolls.push_back(roll);
+                        while (face == dice_size)
+                        {
+                            face = rng_->generate(1, dice_size);
+                            roll.total += face;
+                            faces.push_back(face);
+                        }
                     }
                 }
+                break;
             }
-            break;
+
+            roll.face_count = faces.size() - roll.first_face;
+            dice_rolls.push_back(roll);
         }
-        
-        dice_rolls.emplace_back(total_result);
-        exploded_rolls.emplace_back(individual_exploded_rolls);
     }
 
     //
     // Select the dice to keep or drop
     //
 
-    std::vector<int> dropped_dice_rolls;
-    std::vector<std::vector<int>> dropped_exploded_rolls; // Track explosion details for dropped dice
-    
+    std::pmr::vector<die_roll> dropped_dice_rolls{ &pool_ };
+    auto by_total = [](const die_roll& a, const die_roll& b) { return a.total < b.total; };
+
     switch (selection_mode)
     {
     case dice_selection_mode::all:
@@ -165,130 +684,168 @@ int expression_evaluator::evaluate_dice_expression(const std::string& token, std
     case dice_selection_mode::best:
         while (dice_rolls.size() > selection_count)
         {
-            auto smallest = std::min_element(dice_rolls.begin(), dice_rolls.end());
-            auto smallest_index = std::distance(dice_rolls.begin(), smallest);
-            
+            auto smallest = std::min_element(dice_rolls.begin(), dice_rolls.end(), by_total);
             dropped_dice_rolls.push_back(*smallest);
-            dropped_exploded_rolls.push_back(exploded_rolls[smallest_index]);
-            
             dice_rolls.erase(smallest);
-            exploded_rolls.erase(exploded_rolls.begin() + smallest_index);
         }
         break;
 
     case dice_selection_mode::worst:
         while (dice_rolls.size() > selection_count)
         {
-            auto largest = std::max_element(dice_rolls.begin(), dice_rolls.end());
-            auto largest_index = std::distance(dice_rolls.begin(), largest);
-            
+            auto largest = std::max_element(dice_rolls.begin(), dice_rolls.end(), by_total);
             dropped_dice_rolls.push_back(*largest);
-            dropped_exploded_rolls.push_back(exploded_rolls[largest_index]);
-            
             dice_rolls.erase(largest);
-            exploded_rolls.erase(exploded_rolls.begin() + largest_index);
         }
         break;
 
     default:
-        throw std::runtime_error("Invalid dice modifier: " + match[3].str());
+        throw std::runtime_error("Invalid dice modifier");
     }
 
     //
     // Calculate the total result
     //
 
-    auto result = std::accumulate(dice_rolls.begin(), dice_rolls.end(), 0);
+    int result{ 0 };
+    for (const auto& roll : dice_rolls)
+    {
+        result += roll.total;
+    }
 
     //
-    // Build the roll description string
+    // Build the roll description string: kept dice first, then dropped dice
     //
 
-    std::stringstream roll_description_stream;
-    roll_description_stream << '(';
-    
-    for (size_t i = 0; i < dice_rolls.size(); ++i)
+    if (description)
     {
-        if (i > 0) roll_description_stream << ", ";
-        
-        if (is_exploding && exploded_rolls[i].size() > 1)
+        *description += '(';
+        for (std::size_t i = 0; i < dice_rolls.size(); ++i)
         {
-            // Show exploding dice as [roll1+roll2+...]
-            roll_description_stream << '[';
-            for (size_t j = 0; j < exploded_rolls[i].size(); ++j)
+            if (i > 0)
             {
-                if (j > 0) roll_description_stream << '+';
-                roll_description_stream << exploded_rolls[i][j];
+                *description += ", ";
             }
-            roll_description_stream << ']';
+            append_die(*description, dice_rolls[i], faces, is_exploding);
         }
-        else
+        for (const auto& roll : dropped_dice_rolls)
         {
-            roll_description_stream << dice_rolls[i];
+            *description += ", ";
+            append_die(*description, roll, faces, is_exploding);
         }
+        *description += ')';
     }
-    
-    // Add dropped dice to description
-    for (size_t i = 0; i < dropped_dice_rolls.size(); ++i)
+
+    if (dice)
     {
-        roll_description_stream << ", ";
-        
-        if (is_exploding && dropped_exploded_rolls[i].size() > 1)
+        for (const auto& roll : dice_rolls)
         {
-            // Show exploding dice as [roll1+roll2+...]
-            roll_description_stream << '[';
-            for (size_t j = 0; j < dropped_exploded_rolls[i].size(); ++j)
-            {
-                if (j > 0) roll_description_stream << '+';
-                roll_description_stream << dropped_exploded_rolls[i][j];
-            }
-            roll_description_stream << ']';
+            dice->push_back({ 0, roll.total, static_cast<int>(roll.face_count), true });
         }
-        else
+        for (const auto& roll : dropped_dice_rolls)
         {
-            roll_description_stream << dropped_dice_rolls[i];
+            dice->push_back({ 0, roll.total, static_cast<int>(roll.face_count), false });
         }
     }
 
-    roll_description_stream << ')';
-    auto roll_description = roll_description_stream.str();
+    return result;
+}
+
+void expression_evaluator::roll_exploding_totals(int count, int sides, std::pmr::vector<int>& totals)
+{
+    if (sides < 2)
+    {
+        throw std::runtime_error("A die needs at least two sides to explode");
+    }
+
+    //
+    // A draw from [0, sides^digits) is a string of independent base-sides digits, each one a face. A die's explosion
+    // count is its run of top digits, so it follows the geometric distribution P(k >= m) = sides^-m exactly, and the
+    // digit that ends the run is its final face. Reading dice off packed digits settles several dice per generator
+    // call, and every draw for the pool comes from a bulk request sized to the expected number of digits.
+    //
+
+    int digits = 1;
+    std::int64_t range = sides;
+    while (range * sides <= (std::int64_t{ 1 } << 30))
+    {
+        range *= sides;
+        ++digits;
+    }
+    const auto draw_max = static_cast<int>(range - 1);
+    const auto top = static_cast<std::uint32_t>(sides - 1);
 
-    rolls.emplace_back(roll_description);
+    auto n = static_cast<std::size_t>(count);
+    totals.assign(n, 0);
 
-    return result;
+    std::pmr::vector<int> draws{ &pool_ };
+    std::size_t i = 0;   // The die whose chain is being read
+    while (i < n)
+    {
+        // Each die takes sides/(sides-1) digits on average; a long run just means another, smaller bulk request
+        auto dice_left = n - i;
+        auto expected_digits = dice_left + dice_left / top + 1;
+        draws.resize((expected_digits + digits - 1) / digits);
+        rng_->generate_many(0, draw_max, draws.data(), draws.size());
+
+        for (std::size_t j = 0; j < draws.size() && i < n; ++j)
+        {
+            auto word = static_cast<std::uint32_t>(draws[j]);
+            for (int d = 0; d < digits && i < n; ++d)
+            {
+                auto digit = word % sides;
+                word /= sides;
+                totals[i] += static_cast<int>(digit) + 1;
+                if (digit != top)
+                {
+                    ++i;
+                }
+            }
+        }
+    }
 }
 
-void expression_evaluator::evaluate_operation(std::stack<int>& stack, const std::string& token)
+void expression_evaluator::evaluate_operation(std::pmr::vector<int>& stack, std::string_view token)
 {
-    int op2 = stack.top();
-    stack.pop();
+    if (stack.size() < 2)
+    {
+        throw std::runtime_error("Missing operand for operator: " + std::string(token));
+    }
+
+    int op2 = stack.back();
+    stack.pop_back();
 
-    int op1 = stack.top();
-    stack.pop();
+    int op1 = stack.back();
+    stack.pop_back();
 
     switch (token[0])
     {
     case '+':
-        stack.push(op1 + op2);
+        stack.push_back(op1 + op2);
         break;
 
     case '-':
-        stack.push(op1 - op2);
+        stack.push_back(op1 - op2);
         break;
 
     case '*':
-        stack.push(op1 * op2);
+        stack.push_back(op1 * op2);
+        break;
+
+    case '>':
+    case '<':
+    case '=':
+        stack.push_back(compare(op1, op2, token) ? 1 : 0);
         break;
 
     default:
-        throw std::runtime_error("Unexpected operator: " + token);
+        throw std::runtime_error("Unexpected operator: " + std::string(token));
     }
 }
 
-expression_evaluator::token_type expression_evaluator::get_token_type(const std::string& token)
+expression_evaluator::token_type expression_evaluator::get_token_type(std::string_view token)
 {
-    if (!token.empty() &&
-        std::find_if(token.begin(), token.end(), [](char c) { return !std::isdigit(c); }) == token.end())
+    if (!token.empty() && std::all_of(token.begin(), token.end(), is_digit))
     {
         return token_type::number;
     }
@@ -300,26 +857,26 @@ expression_evaluator::token_type expression_evaluator::get_token_type(const std:
     {
         return token_type::right_parenthesis;
     }
-    else if (token == "+" || token == "-" || token == "*")
+    else if (token == "+" || token == "-" || token == "*" || is_comparison(token))
     {
         return token_type::operation;
     }
-    else if (token.find_first_of("dD") != -1)
+    else if (token.find_first_of("dD") != std::string_view::npos)
     {
         return token_type::dice_expression;
     }
 
-    throw std::runtime_error("Unexpected token type: " + token);
+    throw std::runtime_error("Unexpected token type: " + std::string(token));
 }
 
-expression_evaluator::dice_selection_mode expression_evaluator::get_keeping_mode(const std::string& m)
+expression_evaluator::dice_selection_mode expression_evaluator::get_keeping_mode(std::string_view m)
 {
     if (m.empty())
     {
         return dice_selection_mode::all;
     }
 
-    switch (std::tolower(m[0]))
+    switch (std::tolower(static_cast<unsigned char>(m[0])))
     {
     case 'b':
         return dice_selection_mode::best;
@@ -328,28 +885,81 @@ expression_evaluator::dice_selection_mode expression_evaluator::get_keeping_mode
         return dice_selection_mode::worst;
 
     default:
-        throw std::runtime_error("Invalid dice modifier: " + m);
+        throw std::runtime_error("Invalid dice modifier: " + std::string(m));
     }
 }
 
-std::vector<std::string> expression_evaluator::parse(const std::string expression)
+std::vector<std::string> expression_evaluator::parse(std::string_view expression)
+{
+    token_list tokens{ &pool_ };
+    parse(expression, tokens);
+    return { tokens.begin(), tokens.end() };
+}
+
+void expression_evaluator::parse(std::string_view expression, token_list& tokens)
 {
-    const std::regex expr{ R"(([0-9dbw!]+|[\+\(\)\*-]))" };
-    const std::sregex_iterator rend;
-    std::sregex_iterator rit(expression.begin(), expression.end(), expr);
-    std::vector<std::string> tokens;
-    while (rit != rend)
+    // Runs of dice/number characters form one token, along with any {custom faces} block inside them; operators and
+    // parentheses are single tokens (>= and <= being the only two-character ones); anything else separates tokens.
+    auto is_term_char = [](char c) {
+        return is_digit(c) || c == 'd' || c == 'b' || c == 'w' || c == '!' || c == 'F' || c == '{';
+    };
+    auto is_operator_char = [](char c) {
+        return c == '+' || c == '(' || c == ')' || c == '*' || c == '-' || c == '<' || c == '>' || c == '=';
+    };
+
+    tokens.clear();
+    std::size_t pos = 0;
+    while (pos < expression.size())
     {
-        tokens.emplace_back((rit++)->str());
+        if (is_term_char(expression[pos]))
+        {
+            auto start = pos;
+            while (pos < expression.size() && is_term_char(expression[pos]))
+            {
+                if (expression[pos] == '{')
+                {
+                    // Take everything up to the closing brace; a missing brace is reported by the dice parser
+                    auto close = expression.find('}', pos);
+                    pos = close == std::string_view::npos ? expression.size() : close + 1;
+                }
+                else
+                {
+                    ++pos;
+                }
+            }
+            tokens.push_back(expression.substr(start, pos - start));
+        }
+        else
+        {
+            if (is_operator_char(expression[pos]))
+            {
+                std::size_t length = 1;
+                if ((expression[pos] == '>' || expression[pos] == '<') && pos + 1 < expression.size() &&
+                    expression[pos + 1] == '=')
+                {
+                    length = 2;
+                }
+                tokens.push_back(expression.substr(pos, length));
+                pos += length - 1;
+            }
+            ++pos;
+        }
     }
-    return tokens;
 }
 
 std::vector<std::string> expression_evaluator::convert_infix_to_prefix(const std::vector<std::string>& tokens)
 {
-    std::vector<std::string> result;
-    std::stack<std::string> operator_stack;
+    token_list infix{ tokens.begin(), tokens.end(), &pool_ };
+    token_list prefix{ &pool_ };
+    convert_infix_to_prefix(infix, prefix);
+    return { prefix.begin(), prefix.end() };
+}
+
+void expression_evaluator::convert_infix_to_prefix(const token_list& tokens, token_list& result)
+{
+    token_list operator_stack{ &pool_ };
 
+    result.clear();
     for (const auto& token : tokens)
     {
         auto token_type = get_token_type(token);
@@ -361,28 +971,28 @@ std::vector<std::string> expression_evaluator::convert_infix_to_prefix(const std
             break;
 
         case token_type::left_parenthesis:
-            operator_stack.push(token);
+            operator_stack.push_back(token);
             break;
 
         case token_type::right_parenthesis: {
-            while (!operator_stack.empty() && get_token_type(operator_stack.top()) != token_type::left_parenthesis)
+            while (!operator_stack.empty() && get_token_type(operator_stack.back()) != token_type::left_parenthesis)
             {
-                result.push_back(operator_stack.top());
-                operator_stack.pop();
+                result.push_back(operator_stack.back());
+                operator_stack.pop_back();
             }
 
-            if (get_token_type(operator_stack.top()) != token_type::left_parenthesis)
+            if (operator_stack.empty() || get_token_type(operator_stack.back()) != token_type::left_parenthesis)
             {
                 throw std::runtime_error("No matching parenthesis");
             }
-            operator_stack.pop();
+            operator_stack.pop_back();
         }
         break;
 
         case token_type::operation:
             while (!operator_stack.empty())
             {
-                auto top_token = operator_stack.top();
+                auto top_token = operator_stack.back();
                 auto top_token_precedence = get_precedence(top_token);
                 auto token_precedence = get_precedence(token);
 
@@ -391,26 +1001,24 @@ std::vector<std::string> expression_evaluator::convert_infix_to_prefix(const std
                      get_associativity(token) == assocativity::left_to_right))
                 {
                     result.push_back(top_token);
-                    operator_stack.pop();
+                    operator_stack.pop_back();
                 }
                 else
                 {
                     break;
                 }
             }
-            operator_stack.push(token);
+            operator_stack.push_back(token);
             break;
 
         default:
-            throw std::runtime_error("Unexpected token: " + token);
+            throw std::runtime_error("Unexpected token: " + std::string(token));
         }
     }
 
     while (!operator_stack.empty())
     {
-        result.emplace_back(operator_stack.top());
-        operator_stack.pop();
+        result.push_back(operator_stack.back());
+        operator_stack.pop_back();
     }
-
-    return result;
-}
\ No newline at end of file
+}
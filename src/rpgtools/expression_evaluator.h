@@ -1,14 +1,24 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
-#include <stack>
 #include <unordered_map>
-#include <regex>
+#include <memory_resource>
+#include "custom_die.h"
 #include "random_number_generator.h"
 
+class distribution_table;
+
 class expression_evaluator
 {
     random_number_generator* rng_;
+    const distribution_table* distributions_{ nullptr };
+    custom_die_registry custom_dice_;
+    bool totals_only_{ false };
+
+    // Scratch memory for every container used while evaluating. Freed blocks go back to the pool, so once the
+    // pool has grown to fit an expression, evaluating it again does not touch the upstream resource.
+    std::pmr::unsynchronized_pool_resource pool_;
 
     enum class assocativity { left_to_right, right_to_left };
 
@@ -17,30 +27,146 @@ class expression_evaluator
         int precedence;
         assocativity associativity;
     };
-    
-    // PEMDAS...
-    const std::unordered_map<std::string, operator_info> operators = {
+
+    // PEMDAS, with comparisons below everything so that 1d20+7>=15 compares the whole sum
+    static inline const std::unordered_map<std::string_view, operator_info> operators = {
         { "(", { 0, assocativity::left_to_right } },
         { "*", { 4, assocativity::left_to_right } },
         // { "/", { 4, assocativity::left_to_right } },
         { "+", { 2, assocativity::left_to_right } },
         { "-", { 2, assocativity::left_to_right } },
+        { ">=", { 1, assocativity::left_to_right } },
+        { ">", { 1, assocativity::left_to_right } },
+        { "<=", { 1, assocativity::left_to_right } },
+        { "<", { 1, assocativity::left_to_right } },
+        { "=", { 1, assocativity::left_to_right } },
     };
 
-    int get_precedence(const std::string& op);
-    assocativity get_associativity(const std::string& op);
+    int get_precedence(std::string_view op);
+    assocativity get_associativity(std::string_view op);
 
 public:
     enum class token_type { number, operation, left_parenthesis, right_parenthesis, dice_expression };
     enum class dice_selection_mode { all, best, worst };
 
-    expression_evaluator(random_number_generator* rng);
+    // One dice token such as "4d6b3", "2d6!" or "4dF", broken into its parts
+    struct dice_term
+    {
+        int count;
+        int sides;   // For custom dice, the number of faces
+        bool exploding;
+        dice_selection_mode selection_mode;
+        int selection_count;
+        const custom_die* custom{ nullptr };   // Set for dF, d{0,0,1,1,2} and registered d{name} dice
+    };
+
+    // One die of an evaluated expression, for callers that want the dice themselves rather than a description
+    struct die_result
+    {
+        int term;    // Which dice term of the expression the die belongs to, counting from 0
+        int total;   // Including any explosions
+        int rolls;   // Faces rolled: more than 1 when the die exploded
+        bool kept;   // False when dropped by keep best/worst
+    };
+
+    // Outcome of a target number check such as "1d20+7>=15"
+    struct check_result
+    {
+        int total;      // The left-hand side: what 1d20+7 came to
+        int target;     // The right-hand side: 15
+        bool success;
+        int margin;     // total - target, negated for < and <= so that a larger margin is always better
+    };
+
+    // Tokens are views into the expression (or into the strings of a std::vector<std::string> token list)
+    using token_list = std::pmr::vector<std::string_view>;
+
+    // upstream feeds the evaluator's scratch pool; pass an arena such as std::pmr::monotonic_buffer_resource to keep
+    // evaluation off the global heap entirely.
+    expression_evaluator(random_number_generator* rng,
+                         std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    // When set, evaluations that don't ask for a description or dice sample each tabulated dice term with one lookup
+    // instead of rolling every die. The table must outlive the evaluator.
+    void set_distribution_table(const distribution_table* table);
+
+    // When enabled, exploding terms evaluated without a description or dice read their faces as base-sides digits
+    // packed into bulk generator draws instead of rolling die by die. Totals are distributed exactly as before and
+    // each draw settles several dice; an explosion still costs one digit, so the cost still grows with the length of
+    // a chain, just with a smaller constant. The individual rolls are never produced.
+    void set_totals_only(bool enabled);
 
-    int evaluate(const std::string expression, std::string* description = nullptr);
-    int evaluate_dice_expression(const std::string& token, std::vector<std::string>& rolls);
-    void evaluate_operation(std::stack<int>& stack, const std::string& token);
-    token_type get_token_type(const std::string& token);
-    dice_selection_mode get_keeping_mode(const std::string& m);
-    std::vector<std::string> parse(const std::string expression);
+    // Dice that d{name} can refer to. Inline face lists such as d{0,0,1,1,2} are cached here too.
+    custom_die_registry& custom_dice();
+
+    // Reusing the same description string across calls lets it keep its capacity, so steady-state evaluations make
+    // no heap allocations. The same goes for dice, which is filled with every die rolled, kept dice of each term
+    // first, in the same order as the description.
+    int evaluate(std::string_view expression, std::string* description = nullptr,
+                 std::vector<die_result>* dice = nullptr);
+
+    // Evaluates an expression whose last operation is a comparison: >=, >, <=, < or =. Comparisons can also appear
+    // anywhere in the expressions the other evaluate functions take, where they yield 1 for a pass and 0 for a fail.
+    check_result evaluate_check(std::string_view expression, std::string* description = nullptr,
+                                std::vector<die_result>* dice = nullptr);
+
+    // True when the expression's last operation is a comparison, so that evaluate_check accepts it. (d6>4)+(d6>4)
+    // contains comparisons but is not a check: it adds their results.
+    bool is_check(std::string_view expression);
+
+    // Evaluates tokens already produced by convert_infix_to_prefix, so callers that see the same expression
+    // repeatedly can skip parsing.
+    int evaluate_prefix(const std::vector<std::string>& prefix, std::string* description = nullptr,
+                        std::vector<die_result>* dice = nullptr);
+    int evaluate_prefix(const token_list& prefix, std::string* description = nullptr,
+                        std::vector<die_result>* dice = nullptr);
+
+    // Evaluates prefix count times into results[0..count). The prefix is decoded once, and each dice term is rolled for
+    // a batch of repetitions in one bulk draw before the arithmetic runs, so large batches cost little more than their
+    // dice. Batches hold about max_batch_dice dice, so scratch memory doesn't grow with count. Totals follow the same
+    // distribution as evaluate_prefix, but the generator's values are consumed in a different order.
+    void evaluate_many(const token_list& prefix, std::size_t count, int* results);
+
+    // Largest N that "Nx(expression)" accepts
+    static const std::size_t max_repetitions = 1000000;
+
+    // Splits a repetition such as "6x(4d6b3)" into its count and the expression to repeat. Returns false, leaving
+    // count and inner untouched, when the expression doesn't start with a count followed by x, and throws when the
+    // count is above max_repetitions.
+    bool parse_repetition(std::string_view expression, std::size_t& count, std::string_view& inner);
+
+    // Evaluates "Nx(expression)" N times into results, or a plain expression once, and returns the sum of the results.
+    // When sorted is set, results are ordered highest first.
+    long long evaluate_repeated(std::string_view expression, std::vector<int>& results, bool sorted = false);
+
+    dice_term parse_dice_expression(std::string_view token);
+
+    // Rolls one dice token and appends its "(a, b, [6+2])" description when description is not null, and its dice
+    // (with term 0) when dice is not null
+    int evaluate_dice_expression(std::string_view token, std::string* description,
+                                 std::vector<die_result>* dice = nullptr);
+    int evaluate_dice_expression(const dice_term& term, std::string* description,
+                                 std::vector<die_result>* dice = nullptr);
+
+    // Fills totals with the totals of count exploding dice; see set_totals_only
+    void roll_exploding_totals(int count, int sides, std::pmr::vector<int>& totals);
+
+    void evaluate_operation(std::pmr::vector<int>& stack, std::string_view token);
+    token_type get_token_type(std::string_view token);
+    dice_selection_mode get_keeping_mode(std::string_view m);
+    std::vector<std::string> parse(std::string_view expression);
+    void parse(std::string_view expression, token_list& tokens);
     std::vector<std::string> convert_infix_to_prefix(const std::vector<std::string>& tokens);
+    void convert_infix_to_prefix(const token_list& tokens, token_list& prefix);
+
+private:
+    // Dice drawn per bulk request by evaluate_many
+    static const std::size_t max_batch_dice = 1 << 16;
+
+    // Runs prefix tokens [first, last) on stack without checking how many values are left
+    void evaluate_tokens(token_list::const_iterator first, token_list::const_iterator last,
+                         std::pmr::vector<int>& stack, std::string* description, std::vector<die_result>* dice);
+
+    // Writes the totals of count independent rolls of term to totals[0..count); used by evaluate_many
+    void roll_term_many(const dice_term& term, std::size_t count, int* totals);
 };
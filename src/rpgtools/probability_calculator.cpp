@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include "probability_calculator.h"
+
+namespace
+{
+    // Widest distribution a product may produce, so that something like d1000*d1000*d1000 fails instead of
+    // exhausting memory
+    const long long max_values = 1 << 24;
+
+    // Limits for a single dice term: the widest distribution it may produce, and the most multiply-adds building
+    // it may take, so that 1000d1000 fails at once instead of convolving for minutes
+    const long long max_term_values = 1 << 16;
+    const double max_term_work = 1 << 28;
+
+    // Exploding dice are cut off once the chance of exploding again is below this
+    const double explosion_cutoff = 1e-15;
+
+    dice_distribution constant(int value)
+    {
+        return { value, { 1.0 } };
+    }
+
+    int max_value(const dice_distribution& d)
+    {
+        return d.min_value + static_cast<int>(d.probabilities.size()) - 1;
+    }
+
+    dice_distribution negate(const dice_distribution& d)
+    {
+        return { -max_value(d), std::vector<double>(d.probabilities.rbegin(), d.probabilities.rend()) };
+    }
+
+    // Throws unless the sum of kept dice with die_values possible values each fits the limits above, where work is
+    // what building its distribution costs
+    void check_term_size(long long kept, long long die_values, double work)
+    {
+        if (static_cast<double>(kept) * (die_values - 1) + 1 > max_term_values || work > max_term_work)
+        {
+            throw std::runtime_error("Distribution is too wide to compute");
+        }
+    }
+
+    // Multiply-adds in summing count dice of die_values values each by repeated convolution
+    double convolution_work(double count, double die_values)
+    {
+        return (count - 1) * count * die_values * die_values;
+    }
+
+    dice_distribution multiply(const dice_distribution& a, const dice_distribution& b)
+    {
+        long long corners[] = { static_cast<long long>(a.min_value) * b.min_value,
+                                static_cast<long long>(a.min_value) * max_value(b),
+                                static_cast<long long>(max_value(a)) * b.min_value,
+                                static_cast<long long>(max_value(a)) * max_value(b) };
+        auto [low, high] = std::minmax_element(std::begin(corners), std::end(corners));
+        if (*high - *low >= max_values)
+        {
+            throw std::runtime_error("Distribution is too wide to compute");
+        }
+
+        dice_distribution result{ static_cast<int>(*low), std::vector<double>(*high - *low + 1, 0.0) };
+        for (std::size_t i = 0; i < a.probabilities.size(); ++i)
+        {
+            for (std::size_t j = 0; j < b.probabilities.size(); ++j)
+            {
+                auto product = static_cast<long long>(a.min_value + static_cast<int>(i)) *
+                               (b.min_value + static_cast<int>(j));
+                result.probabilities[product - *low] += a.probabilities[i] * b.probabilities[j];
+            }
+        }
+        return result;
+    }
+}
+
+double probability_calculator::probability(std::string_view expression, std::string_view comparison, int target)
+{
+    return lookup(table(expression), comparison, target);
+}
+
+void probability_calculator::probabilities(const success_query* queries, std::size_t count, double* results)
+{
+    // Queries tend to come in runs against one expression, so only a change of expression needs a table search
+    const cumulative* current{ nullptr };
+    std::string_view current_expression;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (!current || queries[i].expression != current_expression)
+        {
+            current = &table(queries[i].expression);
+            current_expression = queries[i].expression;
+        }
+        results[i] = lookup(*current, queries[i].comparison, queries[i].target);
+    }
+}
+
+std::vector<double> probability_calculator::probabilities(const std::vector<success_query>& queries)
+{
+    std::vector<double> results(queries.size());
+    probabilities(queries.data(), queries.size(), results.data());
+    return results;
+}
+
+dice_distribution probability_calculator::distribution(std::string_view expression)
+{
+    expression_evaluator::token_list tokens;
+    expression_evaluator::token_list prefix;
+    parser_.parse(expression, tokens);
+    parser_.convert_infix_to_prefix(tokens, prefix);
+
+    std::vector<dice_distribution> stack;
+    for (const auto& token : prefix)
+    {
+        switch (parser_.get_token_type(token))
+        {
+        case expression_evaluator::token_type::number: {
+            int value{ 0 };
+            auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+            if (result.ec != std::errc{})
+            {
+                throw std::runtime_error("Number out of range: " + std::string(token));
+            }
+            stack.push_back(constant(value));
+        }
+        break;
+
+        case expression_evaluator::token_type::dice_expression:
+            stack.push_back(term_distribution(parser_.parse_dice_expression(token)));
+            break;
+
+        case expression_evaluator::token_type::operation: {
+            if (stack.size() < 2)
+            {
+                throw std::runtime_error("Missing operand for operator: " + std::string(token));
+            }
+            auto b = std::move(stack.back());
+            stack.pop_back();
+            stack.back() = combine(stack.back(), b, token);
+        }
+        break;
+
+        default:
+            throw std::runtime_error("Unexpected token: " + std::string(token));
+        }
+    }
+
+    if (stack.size() != 1)
+    {
+        throw std::runtime_error("Parse error");
+    }
+
+    return std::move(stack.back());
+}
+
+custom_die_registry& probability_calculator::custom_dice()
+{
+    return parser_.custom_dice();
+}
+
+std::size_t probability_calculator::cached_tables() const
+{
+    return tables_.size();
+}
+
+probability_calculator::cumulative probability_calculator::accumulate(dice_distribution distribution)
+{
+    const auto value_count = distribution.probabilities.size();
+    cumulative result{ std::move(distribution), std::vector<double>(value_count), std::vector<double>(value_count) };
+
+    double running = 0.0;
+    for (std::size_t i = 0; i < value_count; ++i)
+    {
+        running += result.distribution.probabilities[i];
+        result.at_most[i] = running;
+    }
+    running = 0.0;
+    for (std::size_t i = value_count; i-- > 0;)
+    {
+        running += result.distribution.probabilities[i];
+        result.at_least[i] = running;
+    }
+    return result;
+}
+
+double probability_calculator::lookup(const cumulative& table, std::string_view comparison, int target)
+{
+    const auto value_count = static_cast<long long>(table.at_most.size());
+    const auto index = static_cast<long long>(target) - table.distribution.min_value;
+
+    auto at_most = [&](long long i) { return i < 0 ? 0.0 : i >= value_count ? 1.0 : table.at_most[i]; };
+    auto at_least = [&](long long i) { return i <= 0 ? 1.0 : i >= value_count ? 0.0 : table.at_least[i]; };
+
+    if (comparison == ">=")
+    {
+        return at_least(index);
+    }
+    else if (comparison == ">")
+    {
+        return at_least(index + 1);
+    }
+    else if (comparison == "<=")
+    {
+        return at_most(index);
+    }
+    else if (comparison == "<")
+    {
+        return at_most(index - 1);
+    }
+    else if (comparison == "=")
+    {
+        return index < 0 || index >= value_count ? 0.0 : table.distribution.probabilities[index];
+    }
+
+    throw std::runtime_error("Unknown comparison: " + std::string(comparison));
+}
+
+dice_distribution probability_calculator::combine(const dice_distribution& a, const dice_distribution& b,
+                                                  std::string_view op)
+{
+    switch (op[0])
+    {
+    case '+':
+        return convolve(a, b);
+
+    case '-':
+        return convolve(a, negate(b));
+
+    case '*':
+        return multiply(a, b);
+
+    default: {
+        // A comparison passes (1) or fails (0) with the chance that a - b lands on the right side of 0
+        auto success = lookup(accumulate(convolve(a, negate(b))), op, 0);
+        return { 0, { 1.0 - success, success } };
+    }
+    }
+}
+
+const probability_calculator::cumulative& probability_calculator::table(std::string_view expression)
+{
+    auto it = tables_.find(expression);
+    if (it == tables_.end())
+    {
+        auto computed = accumulate(distribution(expression));
+        if (tables_.size() >= max_cached_tables)
+        {
+            tables_.clear();
+        }
+        it = tables_.emplace(std::string{ expression }, std::move(computed)).first;
+    }
+    return it->second;
+}
+
+dice_distribution probability_calculator::term_distribution(const expression_evaluator::dice_term& term)
+{
+    // Keeping none of the dice totals 0 when rolled, too
+    const auto keeping = term.selection_mode != expression_evaluator::dice_selection_mode::all;
+    if (term.count == 0 || (keeping && term.selection_count == 0))
+    {
+        return constant(0);
+    }
+
+    // d66 and d666 never explode when rolled, so they share the plain shapes' exact distributions
+    if (!term.custom && (!term.exploding || term.sides == 66 || term.sides == 666))
+    {
+        const double count = term.count;
+        const double sides = term.sides;
+        const long long die_values = term.sides == 66 ? 56 : term.sides == 666 ? 556 : term.sides;
+        if (keeping && term.selection_count < term.count)
+        {
+            // The keep best/worst table runs over every face, count of dice placed and kept sum so far
+            const double kept = term.selection_count;
+            check_term_size(term.selection_count, term.sides, sides * (count + 1) * (count + 1) * (kept * sides + 1));
+        }
+        else
+        {
+            check_term_size(term.count, die_values, convolution_work(count, die_values));
+        }
+
+        auto plain = term;
+        plain.exploding = false;
+        return compute_distribution(plain);
+    }
+
+    if (keeping && term.selection_count < term.count)
+    {
+        throw std::runtime_error("Distribution not available for this dice term");
+    }
+
+    dice_distribution die;
+    if (term.custom)
+    {
+        // Check the span of the faces before sizing anything by it: d{0,100000000} is one die but 10^8 values
+        const long long span = static_cast<long long>(term.custom->max_face()) - term.custom->min_face() + 1;
+        check_term_size(term.count, span, convolution_work(term.count, span));
+
+        const auto& faces = term.custom->faces();
+        auto chances = term.custom->probabilities();
+        die = { term.custom->min_face(), std::vector<double>(static_cast<std::size_t>(span)) };
+        for (std::size_t i = 0; i < faces.size(); ++i)
+        {
+            die.probabilities[static_cast<long long>(faces[i]) - die.min_value] += chances[i];
+        }
+    }
+    else
+    {
+        if (term.sides < 2)
+        {
+            throw std::runtime_error("A die needs at least two sides to explode");
+        }
+
+        // The exploded die is at least sides values wide, so check that much before building it
+        check_term_size(term.count, term.sides, convolution_work(term.count, term.sides));
+
+        // A die that explodes m times and then stops on face f < sides totals m * sides + f, with chance
+        // sides^-(m + 1). Multiples of sides are never final totals.
+        die.min_value = 1;
+        double chance = 1.0 / term.sides;
+        while (true)
+        {
+            die.probabilities.insert(die.probabilities.end(), term.sides - 1, chance);
+            if (chance < explosion_cutoff)   // chance is also the chance of exploding past this round
+            {
+                break;
+            }
+            die.probabilities.push_back(0.0);
+            chance /= term.sides;
+        }
+    }
+
+    const long long die_values = static_cast<long long>(die.probabilities.size());
+    check_term_size(term.count, die_values, convolution_work(term.count, die_values));
+
+    auto result = die;
+    for (int i = 1; i < term.count; ++i)
+    {
+        result = convolve(result, die);
+    }
+    return result;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "distribution_table.h"
+#include "expression_evaluator.h"
+
+// One target number check, e.g. { "1d20+7", 15 } for "does 1d20+7 beat AC 15?"
+struct success_query
+{
+    std::string_view expression;
+    int target;
+    std::string_view comparison{ ">=" };   // >=, >, <=, < or =
+};
+
+// Exact success chances for target number checks. The first query against an expression computes the cumulative
+// distribution of its total and keeps it, so every later query against that expression is one lookup, whatever the
+// target or comparison.
+class probability_calculator
+{
+public:
+    // Once this many expressions' distributions are cached, the cache is emptied before the next new one is added, so
+    // a long-lived calculator fed arbitrary expressions doesn't grow without bound
+    static const std::size_t max_cached_tables = 1024;
+
+    // P(total comparison target)
+    double probability(std::string_view expression, std::string_view comparison, int target);
+
+    // Answers queries[i] into results[i]
+    void probabilities(const success_query* queries, std::size_t count, double* results);
+    std::vector<double> probabilities(const std::vector<success_query>& queries);
+
+    // Exact distribution of an expression's total, treating every dice term as independent. A comparison inside the
+    // expression is a 0/1 total, as it is when rolled. Exploding dice are cut off once the chance of rolling further
+    // falls below 1e-15; custom or exploding dice with keep best/worst throw, as does any dice term whose total could
+    // take more than 65536 values, such as 1000d1000.
+    dice_distribution distribution(std::string_view expression);
+
+    // Dice that d{name} can refer to
+    custom_die_registry& custom_dice();
+
+    std::size_t cached_tables() const;
+
+private:
+    struct cumulative
+    {
+        dice_distribution distribution;
+        std::vector<double> at_most;    // at_most[i] is P(total <= min_value + i)
+        std::vector<double> at_least;   // at_least[i] is P(total >= min_value + i)
+    };
+
+    // Lets tables_ be searched with a string_view without building a std::string
+    struct expression_hash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view expression) const { return std::hash<std::string_view>{}(expression); }
+    };
+
+    static cumulative accumulate(dice_distribution distribution);
+    static double lookup(const cumulative& table, std::string_view comparison, int target);
+    static dice_distribution combine(const dice_distribution& a, const dice_distribution& b, std::string_view op);
+
+    const cumulative& table(std::string_view expression);
+    dice_distribution term_distribution(const expression_evaluator::dice_term& term);
+
+    expression_evaluator parser_{ nullptr };
+    std::unordered_map<std::string, cumulative, expression_hash, std::equal_to<>> tables_;
+};
@@ -9,11 +9,30 @@ std::default_random_engine& random_number_generator::get_engine()
     return random_engine;
 }
 
+std::default_random_engine& random_number_generator::engine()
+{
+    return own_engine_ ? *own_engine_ : get_engine();
+}
+
 random_number_generator::random_number_generator() = default;
+random_number_generator::random_number_generator(unsigned seed)
+    : own_engine_{ std::make_unique<std::default_random_engine>(seed) }
+{
+}
 random_number_generator::~random_number_generator() = default;
 
 int random_number_generator::generate(int min, int max)
 {
     std::uniform_int_distribution<int> uniform_dist{ min, max };
-    return uniform_dist(get_engine());
+    return uniform_dist(engine());
+}
+
+void random_number_generator::generate_many(int min, int max, int* first, std::size_t count)
+{
+    std::uniform_int_distribution<int> uniform_dist{ min, max };
+    auto& rng_engine = engine();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        first[i] = uniform_dist(rng_engine);
+    }
 }
@@ -1,12 +1,26 @@
 #pragma once
+#include <cstddef>
+#include <memory>
 #include <random>
 
 class random_number_generator
 {
 public:
     random_number_generator();
+
+    // Uses a private engine seeded with the given value instead of the shared one, so each thread can own a
+    // generator without synchronizing with the others.
+    explicit random_number_generator(unsigned seed);
+
     virtual ~random_number_generator();
     virtual int generate(int min, int max);
+
+    // Fills [first, first + count) with values in [min, max]. Generators that override generate() should also
+    // override this so bulk callers see the same sequence.
+    virtual void generate_many(int min, int max, int* first, std::size_t count);
 protected:
     static std::default_random_engine& get_engine();
+    std::default_random_engine& engine();
+private:
+    std::unique_ptr<std::default_random_engine> own_engine_;
 };
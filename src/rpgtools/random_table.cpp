@@ -0,0 +1,521 @@
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "random_table.h"
+#include "distribution_table.h"
+
+namespace
+{
+    bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && is_space(text.front()))
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && is_space(text.back()))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    // Checks every token of an {expression} and that each operator has its operands, as rpg_expression_parse does,
+    // so a malformed table is rejected when it loads rather than on the first roll that reaches the entry
+    void check_prefix(expression_evaluator& evaluator, const std::vector<std::string>& prefix)
+    {
+        std::size_t depth{ 0 };
+        for (const auto& token : prefix)
+        {
+            switch (evaluator.get_token_type(token))
+            {
+            case expression_evaluator::token_type::dice_expression:
+                evaluator.parse_dice_expression(token);
+                ++depth;
+                break;
+
+            case expression_evaluator::token_type::operation:
+                if (depth < 2)
+                {
+                    throw std::runtime_error("Missing operand for operator: " + token);
+                }
+                --depth;
+                break;
+
+            default:
+                ++depth;
+                break;
+            }
+        }
+        if (depth != 1)
+        {
+            throw std::runtime_error("Parse error");
+        }
+    }
+
+    // Splits off the leading run of non-space characters
+    std::string_view next_word(std::string_view& text)
+    {
+        text = trim(text);
+        std::size_t end = 0;
+        while (end < text.size() && !is_space(text[end]))
+        {
+            ++end;
+        }
+        auto word = text.substr(0, end);
+        text = trim(text.substr(end));
+        return word;
+    }
+
+    // Parses "5" or "11-16"
+    bool parse_range(std::string_view range, int& low, int& high)
+    {
+        auto end = range.data() + range.size();
+        auto result = std::from_chars(range.data(), end, low);
+        if (result.ec != std::errc{})
+        {
+            return false;
+        }
+        if (result.ptr == end)
+        {
+            high = low;
+            return true;
+        }
+        if (*result.ptr != '-')
+        {
+            return false;
+        }
+        result = std::from_chars(result.ptr + 1, end, high);
+        return result.ec == std::errc{} && result.ptr == end;
+    }
+
+    void append_number(std::string& out, int value)
+    {
+        char buffer[16];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+}
+
+//
+// random_table
+//
+
+random_table::random_table(std::string name, const expression_evaluator::dice_term& term)
+    : name_{ std::move(name) }, term_{ term }
+{
+    auto distribution = compute_distribution(term_);
+    min_value_ = distribution.min_value;
+    probabilities_ = std::move(distribution.probabilities);
+    index_.assign(probabilities_.size(), no_entry);
+}
+
+const std::string& random_table::name() const
+{
+    return name_;
+}
+
+const expression_evaluator::dice_term& random_table::term() const
+{
+    return term_;
+}
+
+const std::vector<random_table::entry>& random_table::entries() const
+{
+    return entries_;
+}
+
+void random_table::add(int low, int high, std::string text, std::vector<segment> segments)
+{
+    if (low > high)
+    {
+        throw std::runtime_error("Invalid roll range on table " + name_);
+    }
+    if (low < min_value_ || high - min_value_ >= static_cast<int>(index_.size()))
+    {
+        throw std::runtime_error("Roll range outside the dice of table " + name_);
+    }
+
+    for (int roll = low; roll <= high; ++roll)
+    {
+        if (index_[roll - min_value_] != no_entry)
+        {
+            throw std::runtime_error("Overlapping roll range on table " + name_);
+        }
+    }
+
+    auto position = static_cast<std::uint32_t>(entries_.size());
+    for (int roll = low; roll <= high; ++roll)
+    {
+        index_[roll - min_value_] = position;
+    }
+    entries_.push_back({ low, high, std::move(text), std::move(segments) });
+}
+
+void random_table::validate() const
+{
+    for (std::size_t i = 0; i < index_.size(); ++i)
+    {
+        if (probabilities_[i] > 0.0 && index_[i] == no_entry)
+        {
+            throw std::runtime_error("Table " + name_ + " has no entry for roll " +
+                                     std::to_string(min_value_ + static_cast<int>(i)));
+        }
+    }
+}
+
+const random_table::entry& random_table::lookup(int roll) const
+{
+    auto i = static_cast<std::size_t>(roll - min_value_);
+    if (roll < min_value_ || i >= index_.size() || index_[i] == no_entry)
+    {
+        throw std::runtime_error("Roll " + std::to_string(roll) + " is not on table " + name_);
+    }
+    return entries_[index_[i]];
+}
+
+//
+// random_table_set
+//
+
+random_table_set::random_table_set(random_number_generator* rng) : rng_{ rng }, evaluator_{ rng }
+{
+}
+
+void random_table_set::load(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open random table file: " + path);
+    }
+
+    std::ostringstream text;
+    text << file.rdbuf();
+    load_string(text.str());
+}
+
+void random_table_set::load_string(std::string_view text)
+{
+    std::vector<random_table> loaded;
+    int line_number = 0;
+
+    auto fail = [&](const std::string& message) {
+        return std::runtime_error("Random table line " + std::to_string(line_number) + ": " + message);
+    };
+
+    while (!text.empty())
+    {
+        auto end = text.find('\n');
+        auto line = trim(text.substr(0, end));
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+        ++line_number;
+
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+
+        auto first = next_word(line);
+        if (first == "table")
+        {
+            auto name = next_word(line);
+            auto dice = next_word(line);
+            if (name.empty() || dice.empty() || !line.empty())
+            {
+                throw fail("Expected: table <name> <dice>");
+            }
+
+            bool duplicate = names_.find(name) != names_.end();
+            for (const auto& table : loaded)
+            {
+                duplicate = duplicate || table.name() == name;
+            }
+            if (duplicate)
+            {
+                throw fail("Duplicate table name: " + std::string(name));
+            }
+
+            try
+            {
+                loaded.emplace_back(std::string(name), evaluator_.parse_dice_expression(dice));
+            }
+            catch (const std::runtime_error& e)
+            {
+                throw fail(e.what());
+            }
+            continue;
+        }
+
+        if (loaded.empty())
+        {
+            throw fail("Entry outside of a table");
+        }
+
+        int low{ 0 };
+        int high{ 0 };
+        if (!parse_range(first, low, high))
+        {
+            throw fail("Invalid roll range: " + std::string(first));
+        }
+
+        //
+        // Split the entry into literal text, {expressions} and [table references]
+        //
+
+        std::vector<random_table::segment> segments;
+        std::string literal;
+        for (std::size_t pos = 0; pos < line.size();)
+        {
+            char open = line[pos];
+            if (open != '{' && open != '[')
+            {
+                literal += line[pos++];
+                continue;
+            }
+
+            // Expressions may hold braces of their own, such as the faces of d{0,1}, so match them up
+            char close = open == '{' ? '}' : ']';
+            auto close_pos = std::string_view::npos;
+            int depth{ 0 };
+            for (auto i = pos; i < line.size() && close_pos == std::string_view::npos; ++i)
+            {
+                if (line[i] == open)
+                {
+                    ++depth;
+                }
+                else if (line[i] == close && --depth == 0)
+                {
+                    close_pos = i;
+                }
+            }
+            if (close_pos == std::string_view::npos)
+            {
+                throw fail(std::string("Missing ") + close);
+            }
+            auto inner = trim(line.substr(pos + 1, close_pos - pos - 1));
+            pos = close_pos + 1;
+
+            if (!literal.empty())
+            {
+                segments.push_back({ random_table::segment::kind::text, std::move(literal), {}, 0 });
+                literal.clear();
+            }
+
+            if (open == '{')
+            {
+                random_table::segment expression{ random_table::segment::kind::expression, std::string(inner), {}, 0 };
+                try
+                {
+                    expression.prefix = evaluator_.convert_infix_to_prefix(evaluator_.parse(inner));
+                    if (!expression.prefix.empty())
+                    {
+                        check_prefix(evaluator_, expression.prefix);
+                    }
+                }
+                catch (const std::runtime_error& e)
+                {
+                    throw fail(e.what());
+                }
+                if (expression.prefix.empty())
+                {
+                    throw fail("Empty expression");
+                }
+                segments.push_back(std::move(expression));
+            }
+            else
+            {
+                if (inner.empty())
+                {
+                    throw fail("Empty table reference");
+                }
+                segments.push_back({ random_table::segment::kind::table, std::string(inner), {}, 0 });
+            }
+        }
+        if (!literal.empty())
+        {
+            segments.push_back({ random_table::segment::kind::text, std::move(literal), {}, 0 });
+        }
+
+        try
+        {
+            loaded.back().add(low, high, std::string(line), std::move(segments));
+        }
+        catch (const std::runtime_error& e)
+        {
+            throw fail(e.what());
+        }
+    }
+
+    for (const auto& table : loaded)
+    {
+        table.validate();
+    }
+
+    //
+    // Add the new tables and link every reference. A load that fails leaves the set as it was.
+    //
+
+    auto first_new = tables_.size();
+    for (auto& table : loaded)
+    {
+        names_.emplace(table.name(), tables_.size());
+        tables_.push_back(std::move(table));
+    }
+
+    try
+    {
+        link();
+    }
+    catch (...)
+    {
+        for (auto i = first_new; i < tables_.size(); ++i)
+        {
+            names_.erase(tables_[i].name());
+        }
+        tables_.erase(tables_.begin() + first_new, tables_.end());
+        throw;
+    }
+}
+
+void random_table_set::link()
+{
+    for (auto& table : tables_)
+    {
+        for (auto& entry : table.entries_)
+        {
+            for (auto& segment : entry.segments)
+            {
+                if (segment.type == random_table::segment::kind::table)
+                {
+                    auto it = names_.find(segment.text);
+                    if (it == names_.end())
+                    {
+                        throw std::runtime_error("Unknown table [" + segment.text + "] referenced by table " +
+                                                 table.name());
+                    }
+                    segment.table_index = it->second;
+                }
+            }
+        }
+    }
+}
+
+std::size_t random_table_set::size() const
+{
+    return tables_.size();
+}
+
+bool random_table_set::contains(std::string_view name) const
+{
+    return names_.find(name) != names_.end();
+}
+
+std::size_t random_table_set::find(std::string_view name) const
+{
+    auto it = names_.find(name);
+    if (it == names_.end())
+    {
+        throw std::runtime_error("Unknown table: " + std::string(name));
+    }
+    return it->second;
+}
+
+const random_table& random_table_set::get(std::string_view name) const
+{
+    return tables_[find(name)];
+}
+
+std::string random_table_set::roll(std::string_view name)
+{
+    std::string result;
+    roll_into(find(name), result, 0);
+    return result;
+}
+
+void random_table_set::roll_many(std::string_view name, std::size_t count, std::vector<std::string>& results)
+{
+    const auto& table = tables_[find(name)];
+    const auto& term = table.term();
+
+    results.resize(count);
+
+    //
+    // Roll every result up front. A single die is drawn in bulk; anything else goes through the evaluator.
+    //
+
+    rolls_.resize(count);
+    bool single_die = term.count == 1 && !term.exploding &&
+                      term.selection_mode == expression_evaluator::dice_selection_mode::all;
+
+    if (single_die && (term.sides == 66 || term.sides == 666))
+    {
+        // Draw every digit, then fold each group of digits into its roll in place
+        std::size_t digits = term.sides == 66 ? 2 : 3;
+        rolls_.resize(count * digits);
+        rng_->generate_many(1, 6, rolls_.data(), rolls_.size());
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            int roll = 0;
+            for (std::size_t d = 0; d < digits; ++d)
+            {
+                roll = roll * 10 + rolls_[i * digits + d];
+            }
+            rolls_[i] = roll;
+        }
+    }
+    else if (single_die)
+    {
+        rng_->generate_many(1, term.sides, rolls_.data(), count);
+    }
+    else
+    {
+        for (auto& roll : rolls_)
+        {
+            roll = evaluator_.evaluate_dice_expression(term, nullptr);
+        }
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        results[i].clear();
+        resolve(table.lookup(rolls_[i]), results[i], 0);
+    }
+}
+
+void random_table_set::roll_into(std::size_t table_index, std::string& out, int depth)
+{
+    const auto& table = tables_[table_index];
+    if (depth > max_depth)
+    {
+        throw std::runtime_error("Table references nested too deeply at table " + table.name());
+    }
+
+    resolve(table.lookup(evaluator_.evaluate_dice_expression(table.term(), nullptr)), out, depth);
+}
+
+void random_table_set::resolve(const random_table::entry& entry, std::string& out, int depth)
+{
+    for (const auto& segment : entry.segments)
+    {
+        switch (segment.type)
+        {
+        case random_table::segment::kind::text:
+            out += segment.text;
+            break;
+
+        case random_table::segment::kind::expression:
+            append_number(out, evaluator_.evaluate_prefix(segment.prefix));
+            break;
+
+        case random_table::segment::kind::table:
+            roll_into(segment.table_index, out, depth + 1);
+            break;
+        }
+    }
+}
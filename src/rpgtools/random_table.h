@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "expression_evaluator.h"
+#include "random_number_generator.h"
+
+// A table of results indexed by a dice roll, such as a d66 encounter table or a d100 loot table. Every possible roll
+// is mapped straight to its entry through a dense array, so a lookup is a single index.
+class random_table
+{
+public:
+    // Piece of an entry's text: literal text, a nested "{2d6+1}" expression, or a "[name]" reference to a table
+    struct segment
+    {
+        enum class kind { text, expression, table } type;
+        std::string text;                  // Literal text, or the referenced table's name
+        std::vector<std::string> prefix;   // Expression tokens, already converted to prefix order
+        std::size_t table_index{ 0 };      // Referenced table's position in its random_table_set
+    };
+
+    struct entry
+    {
+        int low;
+        int high;
+        std::string text;
+        std::vector<segment> segments;
+    };
+
+    random_table(std::string name, const expression_evaluator::dice_term& term);
+
+    const std::string& name() const;
+    const expression_evaluator::dice_term& term() const;
+    const std::vector<entry>& entries() const;
+
+    // Adds the entry for rolls low through high. Throws if the range overlaps an earlier entry or can't be rolled.
+    void add(int low, int high, std::string text, std::vector<segment> segments);
+
+    // Throws unless every possible roll of the table's dice has an entry
+    void validate() const;
+
+    // The entry for a roll, in constant time; throws if the roll isn't on the table
+    const entry& lookup(int roll) const;
+
+private:
+    friend class random_table_set;
+
+    static constexpr std::uint32_t no_entry = 0xffffffff;
+
+    std::string name_;
+    expression_evaluator::dice_term term_;
+    int min_value_;
+    std::vector<double> probabilities_;   // Which rolls are possible, from compute_distribution
+    std::vector<std::uint32_t> index_;    // index_[roll - min_value_] is the roll's position in entries_
+    std::vector<entry> entries_;
+};
+
+// A set of named tables whose entries can roll nested expressions and refer to each other.
+//
+// Tables are loaded from text:
+//
+//   # Comments and blank lines are ignored
+//   table encounter d66
+//   11-16  {d6+1} wolves
+//   21-36  A traveller carrying [trinket]
+//   41-66  Nothing
+//
+//   table trinket d6
+//   1-3    a brass key
+//   4-6    {2d6} silver coins
+//
+// Each entry line is a roll or roll range followed by its text. References are linked when a load completes, so a
+// table may refer to any table in the same text or in an earlier load.
+class random_table_set
+{
+public:
+    // Nested references deeper than this are reported as errors rather than followed, which also catches cycles
+    static const int max_depth = 32;
+
+    explicit random_table_set(random_number_generator* rng);
+
+    void load(const std::string& path);
+    void load_string(std::string_view text);
+
+    std::size_t size() const;
+    bool contains(std::string_view name) const;
+    const random_table& get(std::string_view name) const;
+
+    // Rolls on the table and returns the entry's text with every expression and reference resolved
+    std::string roll(std::string_view name);
+
+    // Rolls count times, reusing the strings already in results. Single-die tables (dN, d66, d666) draw all of their
+    // rolls with one bulk request to the generator.
+    void roll_many(std::string_view name, std::size_t count, std::vector<std::string>& results);
+
+private:
+    std::size_t find(std::string_view name) const;
+    void link();
+    void resolve(const random_table::entry& entry, std::string& out, int depth);
+    void roll_into(std::size_t table_index, std::string& out, int depth);
+
+    // Lets names_ be searched with a string_view without building a std::string
+    struct name_hash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    random_number_generator* rng_;
+    expression_evaluator evaluator_;
+    std::vector<random_table> tables_;
+    std::unordered_map<std::string, std::size_t, name_hash, std::equal_to<>> names_;
+    std::vector<int> rolls_;   // Scratch for roll_many
+};
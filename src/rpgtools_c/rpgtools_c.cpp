@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "rpgtools/expression_evaluator.h"
+#include "rpgtools/random_number_generator.h"
+#include "rpgtools_c.h"
+
+struct rpg_session
+{
+    explicit rpg_session(unsigned seed) : rng{ seed }, evaluator{ &rng }
+    {
+    }
+
+    random_number_generator rng;
+    expression_evaluator evaluator;
+    std::string description;                             // Scratch for rpg_eval_description
+    std::vector<expression_evaluator::die_result> dice;   // Scratch for rpg_eval_batch_dice
+};
+
+struct rpg_expression
+{
+    std::string text;
+    expression_evaluator::token_list prefix;   // Views into text
+    std::size_t dice_count{ 0 };
+};
+
+namespace
+{
+    thread_local std::string last_error;
+
+    void set_error(const char* message)
+    {
+        try
+        {
+            last_error = message;
+        }
+        catch (...)
+        {
+            last_error.clear();
+        }
+    }
+
+    // Runs f, turning any exception into a status so that none cross the C boundary
+    template <typename F>
+    rpg_status guard(rpg_status failure, F f)
+    {
+        try
+        {
+            return f();
+        }
+        catch (const std::bad_alloc&)
+        {
+            set_error("Out of memory");
+            return RPG_ERROR_OUT_OF_MEMORY;
+        }
+        catch (const std::exception& e)
+        {
+            set_error(e.what());
+            return failure;
+        }
+        catch (...)
+        {
+            set_error("Unknown error");
+            return failure;
+        }
+    }
+
+    rpg_status invalid_argument(const char* message)
+    {
+        set_error(message);
+        return RPG_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+uint32_t rpg_abi_version(void)
+{
+    return RPG_ABI_VERSION;
+}
+
+const char* rpg_last_error(void)
+{
+    return last_error.c_str();
+}
+
+//
+// Sessions
+//
+
+rpg_status rpg_session_create(uint32_t seed, rpg_session** session)
+{
+    if (!session)
+    {
+        return invalid_argument("session is null");
+    }
+
+    return guard(RPG_ERROR_INVALID_ARGUMENT, [&]() {
+        if (seed == 0)
+        {
+            std::random_device random_seed;
+            seed = random_seed();
+        }
+        *session = new rpg_session{ seed };
+        return RPG_OK;
+    });
+}
+
+void rpg_session_destroy(rpg_session* session)
+{
+    delete session;
+}
+
+rpg_status rpg_session_set_totals_only(rpg_session* session, int enabled)
+{
+    if (!session)
+    {
+        return invalid_argument("session is null");
+    }
+
+    session->evaluator.set_totals_only(enabled != 0);
+    return RPG_OK;
+}
+
+//
+// Expressions
+//
+
+rpg_status rpg_expression_parse(const char* text, size_t length, rpg_expression** expression)
+{
+    if (!expression || (!text && length > 0))
+    {
+        return invalid_argument("text or expression is null");
+    }
+
+    return guard(RPG_ERROR_PARSE, [&]() {
+        auto parsed = std::make_unique<rpg_expression>();
+        parsed->text.assign(text, length);
+
+        expression_evaluator parser{ nullptr };
+        expression_evaluator::token_list tokens;
+        parser.parse(parsed->text, tokens);
+        parser.convert_infix_to_prefix(tokens, parsed->prefix);
+
+        // Check every token and the operand count now, so that evaluation can only fail for reasons a roll causes
+        std::size_t depth{ 0 };
+        for (const auto& token : parsed->prefix)
+        {
+            switch (parser.get_token_type(token))
+            {
+            case expression_evaluator::token_type::dice_expression:
+                parsed->dice_count += static_cast<std::size_t>(parser.parse_dice_expression(token).count);
+                ++depth;
+                break;
+
+            case expression_evaluator::token_type::operation:
+                if (depth < 2)
+                {
+                    throw std::runtime_error("Missing operand for operator: " + std::string(token));
+                }
+                --depth;
+                break;
+
+            default:
+                ++depth;
+                break;
+            }
+        }
+        if (depth != 1)
+        {
+            throw std::runtime_error("Parse error");
+        }
+
+        *expression = parsed.release();
+        return RPG_OK;
+    });
+}
+
+void rpg_expression_destroy(rpg_expression* expression)
+{
+    delete expression;
+}
+
+size_t rpg_expression_dice_count(const rpg_expression* expression)
+{
+    return expression ? expression->dice_count : 0;
+}
+
+//
+// Evaluation
+//
+
+rpg_status rpg_eval(rpg_session* session, const rpg_expression* expression, int32_t* result)
+{
+    return rpg_eval_batch(session, expression, 1, result);
+}
+
+rpg_status rpg_eval_batch(rpg_session* session, const rpg_expression* expression, size_t count, int32_t* results)
+{
+    if (!session || !expression || (!results && count > 0))
+    {
+        return invalid_argument("session, expression or results is null");
+    }
+
+    static_assert(std::is_same_v<int32_t, int>, "results are written through the evaluator's int interface");
+    return guard(RPG_ERROR_EVALUATION, [&]() {
+        session->evaluator.evaluate_many(expression->prefix, count, results);
+        return RPG_OK;
+    });
+}
+
+rpg_status rpg_eval_batch_dice(rpg_session* session, const rpg_expression* expression, size_t count,
+                               int32_t* results, rpg_die* dice, size_t dice_capacity)
+{
+    if (!session || !expression || (!results && count > 0) || (!dice && dice_capacity > 0))
+    {
+        return invalid_argument("session, expression, results or dice is null");
+    }
+
+    auto stride = expression->dice_count;
+    if (stride > 0 && dice_capacity / stride < count)
+    {
+        set_error("dice buffer is smaller than count * rpg_expression_dice_count");
+        return RPG_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    return guard(RPG_ERROR_EVALUATION, [&]() {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            results[i] = session->evaluator.evaluate_prefix(expression->prefix, nullptr, &session->dice);
+
+            auto out = dice + i * stride;
+            for (std::size_t j = 0; j < stride; ++j)
+            {
+                const auto& die = session->dice[j];
+                out[j] = { die.term, die.total, die.rolls, die.kept ? 1 : 0 };
+            }
+        }
+        return RPG_OK;
+    });
+}
+
+rpg_status rpg_eval_description(rpg_session* session, const rpg_expression* expression, int32_t* result,
+                                char* buffer, size_t capacity, size_t* length)
+{
+    if (!session || !expression || !result || !length || (!buffer && capacity > 0))
+    {
+        return invalid_argument("session, expression, result, buffer or length is null");
+    }
+
+    return guard(RPG_ERROR_EVALUATION, [&]() {
+        *result = session->evaluator.evaluate_prefix(expression->prefix, &session->description);
+        *length = session->description.size();
+        if (capacity > 0)
+        {
+            auto copied = std::min(session->description.size(), capacity - 1);
+            std::memcpy(buffer, session->description.data(), copied);
+            buffer[copied] = '\0';
+        }
+
+        if (capacity <= session->description.size())
+        {
+            set_error("description buffer is too small");
+            return RPG_ERROR_BUFFER_TOO_SMALL;
+        }
+        return RPG_OK;
+    });
+}
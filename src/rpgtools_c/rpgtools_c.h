@@ -0,0 +1,103 @@
+#ifndef RPGTOOLS_C_H
+#define RPGTOOLS_C_H
+
+/*
+ * Stable C interface to rpgtools for use from other languages.
+ *
+ * Expressions are parsed once into an rpg_expression, which is immutable and may be shared between threads. Rolls
+ * are made through an rpg_session, which owns a random number generator and evaluator and must be used by one
+ * thread at a time. Every result is written to memory owned by the caller, and a session reuses its own scratch
+ * memory, so repeated calls make no allocations the caller has to free.
+ *
+ * Functions return RPG_OK on success. On failure, rpg_last_error() describes the error on the calling thread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifdef RPGTOOLS_C_EXPORTS
+#define RPG_API __declspec(dllexport)
+#else
+#define RPG_API __declspec(dllimport)
+#endif
+#else
+#define RPG_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped only when an existing declaration changes incompatibly */
+#define RPG_ABI_VERSION 1
+
+typedef struct rpg_session rpg_session;
+typedef struct rpg_expression rpg_expression;
+
+typedef enum rpg_status
+{
+    RPG_OK = 0,
+    RPG_ERROR_INVALID_ARGUMENT = 1,
+    RPG_ERROR_PARSE = 2,
+    RPG_ERROR_EVALUATION = 3,
+    RPG_ERROR_BUFFER_TOO_SMALL = 4,
+    RPG_ERROR_OUT_OF_MEMORY = 5
+} rpg_status;
+
+/* One die of a roll */
+typedef struct rpg_die
+{
+    int32_t term;  /* Which dice term of the expression, counting from 0 */
+    int32_t total; /* Including any explosions */
+    int32_t rolls; /* Faces rolled: more than 1 when the die exploded */
+    int32_t kept;  /* 0 when dropped by keep best/worst */
+} rpg_die;
+
+RPG_API uint32_t rpg_abi_version(void);
+
+/* Error message for the last failed call on this thread; valid until the thread's next failed call */
+RPG_API const char* rpg_last_error(void);
+
+/* A seed of 0 picks a random seed */
+RPG_API rpg_status rpg_session_create(uint32_t seed, rpg_session** session);
+RPG_API void rpg_session_destroy(rpg_session* session);
+
+/* See expression_evaluator::set_totals_only; affects rpg_eval and rpg_eval_batch only */
+RPG_API rpg_status rpg_session_set_totals_only(rpg_session* session, int enabled);
+
+/* text need not be NUL-terminated */
+RPG_API rpg_status rpg_expression_parse(const char* text, size_t length, rpg_expression** expression);
+RPG_API void rpg_expression_destroy(rpg_expression* expression);
+
+/* Number of dice every roll of the expression produces, which is the rpg_die stride for rpg_eval_batch_dice */
+RPG_API size_t rpg_expression_dice_count(const rpg_expression* expression);
+
+RPG_API rpg_status rpg_eval(rpg_session* session, const rpg_expression* expression, int32_t* result);
+
+/* Rolls the expression count times into results[0..count), drawing each dice term for the whole batch at once */
+RPG_API rpg_status rpg_eval_batch(rpg_session* session, const rpg_expression* expression, size_t count,
+                                  int32_t* results);
+
+/*
+ * Rolls the expression count times into results[0..count), and writes the dice of roll i to
+ * dice[i * stride .. (i + 1) * stride), where stride is rpg_expression_dice_count(expression). dice_capacity is the
+ * number of rpg_die entries available; if it is less than count * stride, nothing is rolled and
+ * RPG_ERROR_BUFFER_TOO_SMALL is returned.
+ */
+RPG_API rpg_status rpg_eval_batch_dice(rpg_session* session, const rpg_expression* expression, size_t count,
+                                       int32_t* results, rpg_die* dice, size_t dice_capacity);
+
+/*
+ * Rolls once and writes the "(4, 3)" style description as a NUL-terminated string. *length receives the
+ * description's length without the terminator. If capacity is too small the description is truncated and
+ * RPG_ERROR_BUFFER_TOO_SMALL is returned, with *result and *length still set.
+ */
+RPG_API rpg_status rpg_eval_description(rpg_session* session, const rpg_expression* expression, int32_t* result,
+                                        char* buffer, size_t capacity, size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
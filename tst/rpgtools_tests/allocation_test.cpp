@@ -0,0 +1,130 @@
+#include <gtest\gtest.h>
+#include <gmock\gmock.h>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include "rpgtools\expression_evaluator.h"
+#include "rpgtools\random_number_generator.h"
+
+//
+// Counting replacements for the global allocation functions. Only allocations made while counting is switched on
+// are recorded, so gtest's own bookkeeping doesn't show up.
+//
+
+namespace
+{
+    bool counting_allocations{ false };
+    std::size_t allocation_count{ 0 };
+
+    void* counted_allocate(std::size_t size)
+    {
+        if (counting_allocations)
+        {
+            ++allocation_count;
+        }
+
+        if (void* p = std::malloc(size ? size : 1))
+        {
+            return p;
+        }
+        throw std::bad_alloc{};
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    return counted_allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return counted_allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+class allocation_test : public ::testing::Test
+{
+protected:
+    random_number_generator rng{ 42 };
+
+    const char* expressions[7] = { "4d6b3+2",  "(2d6+3)*2", "2d20b1+5", "d66",
+                                   "d666-100", "10d10w3",   "3d{0,0,1,1,2}+4dF+10" };
+
+    template <typename F>
+    std::size_t count_allocations(F f)
+    {
+        allocation_count = 0;
+        counting_allocations = true;
+        f();
+        counting_allocations = false;
+        return allocation_count;
+    }
+};
+
+TEST_F(allocation_test, steady_state_evaluation_does_not_allocate)
+{
+    expression_evaluator evaluator{ &rng };
+    std::string description;
+    description.reserve(256);
+
+    // The first pass grows the evaluator's pool to fit each expression
+    for (auto expression : expressions)
+    {
+        evaluator.evaluate(expression, &description);
+    }
+
+    auto count = count_allocations([&]() {
+        for (int i = 0; i < 1000; ++i)
+        {
+            for (auto expression : expressions)
+            {
+                evaluator.evaluate(expression, &description);
+                evaluator.evaluate(expression);
+            }
+        }
+    });
+
+    EXPECT_EQ(count, 0u);
+}
+
+TEST_F(allocation_test, evaluation_runs_from_a_caller_supplied_arena)
+{
+    alignas(std::max_align_t) char buffer[64 * 1024];
+    std::pmr::monotonic_buffer_resource arena{ buffer, sizeof(buffer), std::pmr::null_memory_resource() };
+
+    // Inline custom dice are built on the heap the first time they are seen, so build that one up front
+    expression_evaluator evaluator{ &rng, &arena };
+    evaluator.custom_dice().resolve("0,0,1,1,2");
+
+    auto count = count_allocations([&]() {
+        for (int i = 0; i < 1000; ++i)
+        {
+            for (auto expression : expressions)
+            {
+                EXPECT_GT(evaluator.evaluate(expression), 0);
+            }
+        }
+    });
+
+    EXPECT_EQ(count, 0u);
+}
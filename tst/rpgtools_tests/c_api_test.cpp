@@ -0,0 +1,127 @@
+#include <gtest\gtest.h>
+#include <gmock\gmock.h>
+#include <cstring>
+#include <vector>
+#include "rpgtools_c\rpgtools_c.h"
+
+using ::testing::AllOf;
+using ::testing::Each;
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Le;
+using ::testing::StrEq;
+
+class c_api_test : public ::testing::Test
+{
+protected:
+    rpg_session* session{ nullptr };
+    rpg_expression* expression{ nullptr };
+
+    void SetUp() override
+    {
+        ASSERT_THAT(rpg_session_create(42, &session), Eq(RPG_OK));
+    }
+
+    void TearDown() override
+    {
+        rpg_expression_destroy(expression);
+        rpg_session_destroy(session);
+    }
+
+    rpg_status parse(const char* text)
+    {
+        rpg_expression_destroy(expression);
+        expression = nullptr;
+        return rpg_expression_parse(text, std::strlen(text), &expression);
+    }
+};
+
+TEST_F(c_api_test, batch_fills_caller_buffer)
+{
+    ASSERT_THAT(parse("2d6+3"), Eq(RPG_OK));
+
+    std::vector<int32_t> results(10000);
+    ASSERT_THAT(rpg_eval_batch(session, expression, results.size(), results.data()), Eq(RPG_OK));
+    EXPECT_THAT(results, Each(AllOf(Ge(5), Le(15))));
+}
+
+TEST_F(c_api_test, seeded_sessions_repeat)
+{
+    ASSERT_THAT(parse("3d20"), Eq(RPG_OK));
+    rpg_session* other{ nullptr };
+    ASSERT_THAT(rpg_session_create(42, &other), Eq(RPG_OK));
+
+    int32_t first[100];
+    int32_t second[100];
+    rpg_eval_batch(session, expression, 100, first);
+    rpg_eval_batch(other, expression, 100, second);
+    rpg_session_destroy(other);
+
+    EXPECT_EQ(std::memcmp(first, second, sizeof(first)), 0);
+}
+
+TEST_F(c_api_test, dice_are_written_at_a_fixed_stride)
+{
+    ASSERT_THAT(parse("4d6b3+d8"), Eq(RPG_OK));
+    auto stride = rpg_expression_dice_count(expression);
+    ASSERT_THAT(stride, Eq(5u));
+
+    const std::size_t count = 50;
+    std::vector<int32_t> results(count);
+    std::vector<rpg_die> dice(count * stride);
+    ASSERT_THAT(rpg_eval_batch_dice(session, expression, count, results.data(), dice.data(), dice.size()),
+                Eq(RPG_OK));
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        int32_t kept_total{ 0 };
+        int kept{ 0 };
+        for (std::size_t j = 0; j < stride; ++j)
+        {
+            const auto& die = dice[i * stride + j];
+            EXPECT_THAT(die.term, Eq(j < 4 ? 0 : 1));
+            EXPECT_THAT(die.rolls, Eq(1));
+            kept_total += die.kept ? die.total : 0;
+            kept += die.kept;
+        }
+        EXPECT_THAT(kept, Eq(4));
+        EXPECT_THAT(kept_total, Eq(results[i]));
+    }
+}
+
+TEST_F(c_api_test, small_dice_buffer_is_rejected)
+{
+    ASSERT_THAT(parse("4d6"), Eq(RPG_OK));
+    int32_t results[2];
+    rpg_die dice[7];
+    EXPECT_THAT(rpg_eval_batch_dice(session, expression, 2, results, dice, 7), Eq(RPG_ERROR_BUFFER_TOO_SMALL));
+}
+
+TEST_F(c_api_test, description_is_truncated_to_capacity)
+{
+    ASSERT_THAT(parse("3d6"), Eq(RPG_OK));
+
+    int32_t result{ 0 };
+    char buffer[64];
+    std::size_t length{ 0 };
+    ASSERT_THAT(rpg_eval_description(session, expression, &result, buffer, sizeof(buffer), &length), Eq(RPG_OK));
+    EXPECT_THAT(length, Eq(std::strlen(buffer)));
+    EXPECT_THAT(buffer[0], Eq('('));
+
+    char small[4];
+    EXPECT_THAT(rpg_eval_description(session, expression, &result, small, sizeof(small), &length),
+                Eq(RPG_ERROR_BUFFER_TOO_SMALL));
+    EXPECT_THAT(std::strlen(small), Eq(3u));
+    EXPECT_THAT(length, Ge(9u));
+}
+
+TEST_F(c_api_test, errors_are_reported_not_thrown)
+{
+    EXPECT_THAT(parse("1+"), Eq(RPG_ERROR_PARSE));
+    EXPECT_THAT(rpg_last_error(), StrEq("Missing operand for operator: +"));
+    EXPECT_THAT(expression, Eq(nullptr));
+
+    EXPECT_THAT(parse("(1+2"), Eq(RPG_ERROR_PARSE));
+    EXPECT_THAT(parse("2x6"), Eq(RPG_ERROR_PARSE));
+    EXPECT_THAT(rpg_eval(session, nullptr, nullptr), Eq(RPG_ERROR_INVALID_ARGUMENT));
+}
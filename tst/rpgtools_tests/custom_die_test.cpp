@@ -0,0 +1,125 @@
+#include <gtest\gtest.h>
+#include <gmock\gmock.h>
+#include <cstdint>
+#include <map>
+#include "expression_evaluator_test.h"
+#include "rpgtools\custom_die.h"
+#include "rpgtools\distribution_table.h"
+
+using ::testing::DoubleNear;
+using ::testing::Eq;
+using ::testing::Le;
+using ::testing::NotNull;
+using ::testing::Return;
+using ::testing::StrEq;
+
+struct custom_die_test : public expression_evaluator_test
+{
+    std::string description;
+
+    // The random word that selects face index k of an unweighted n-faced die
+    static int word_for(int k, int n)
+    {
+        return static_cast<int>(((std::int64_t{ k } << 31) + n - 1) / n);
+    }
+};
+
+TEST_F(custom_die_test, fudge_dice_sum)
+{
+    EXPECT_CALL(rng, generate(0, 0x7fffffff))
+        .WillOnce(Return(word_for(2, 3)))
+        .WillOnce(Return(word_for(1, 3)))
+        .WillOnce(Return(word_for(2, 3)))
+        .WillOnce(Return(word_for(0, 3)));
+    auto result = eval.evaluate("4dF+2", &description);
+    EXPECT_THAT(result, Eq(3));
+    EXPECT_THAT(description, StrEq("(1, 0, 1, -1)"));
+}
+
+TEST_F(custom_die_test, inline_faces_keep_best)
+{
+    EXPECT_CALL(rng, generate(0, 0x7fffffff))
+        .WillOnce(Return(word_for(0, 5)))
+        .WillOnce(Return(word_for(4, 5)))
+        .WillOnce(Return(word_for(2, 5)));
+    auto result = eval.evaluate("3d{0,0,1,1,2}b2", &description);
+    EXPECT_THAT(result, Eq(3));
+    EXPECT_THAT(description, StrEq("(2, 1, 0)"));
+}
+
+TEST_F(custom_die_test, registered_dice_by_name)
+{
+    eval.custom_dice().add("boost", { 0, 0, 1, 1, 2, 2 });
+    EXPECT_CALL(rng, generate(0, 0x7fffffff)).WillOnce(Return(word_for(5, 6))).WillOnce(Return(word_for(3, 6)));
+    EXPECT_THAT(eval.evaluate("2d{boost}", &description), Eq(3));
+    EXPECT_THAT(description, StrEq("(2, 1)"));
+}
+
+TEST_F(custom_die_test, bad_definitions_throw)
+{
+    EXPECT_THROW(eval.evaluate("d{missing}"), std::runtime_error);
+    EXPECT_THROW(eval.evaluate("d{1,x}"), std::runtime_error);
+    EXPECT_THROW(eval.evaluate("d{1,2"), std::runtime_error);
+    EXPECT_THROW(eval.evaluate("3dF!"), std::runtime_error);
+    EXPECT_THROW(eval.custom_dice().add("F", { 1 }), std::runtime_error);
+    EXPECT_THROW(custom_die({ 1, 2 }, { 1.0 }), std::runtime_error);
+}
+
+TEST(custom_die_registry_test, inline_cache_is_bounded)
+{
+    custom_die_registry registry;
+    registry.add("boost", { 0, 0, 1, 1, 2, 2 });
+
+    const auto& first = registry.resolve("0,1");
+    EXPECT_THAT(&registry.resolve("0,1"), Eq(&first));
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        registry.resolve("0," + std::to_string(i + 2));
+        EXPECT_THAT(registry.cached_inline_dice(), Le(custom_die_registry::max_cached_inline_dice));
+    }
+
+    ASSERT_THAT(registry.find("boost"), NotNull());
+    EXPECT_THAT(registry.resolve("boost").faces().size(), Eq(6u));
+    EXPECT_THAT(registry.resolve("3,4").faces()[1], Eq(4));
+}
+
+TEST_F(custom_die_test, custom_dice_are_not_tabulated)
+{
+    EXPECT_THROW(compute_distribution(eval.parse_dice_expression("4dF")), std::runtime_error);
+}
+
+TEST(custom_die_sampling_test, weighted_faces_follow_their_weights)
+{
+    random_number_generator rng{ 7 };
+    custom_die die{ { 1, 2, 3 }, { 6.0, 3.0, 1.0 } };
+
+    const std::size_t draws = 200000;
+    std::vector<int> faces(draws);
+    die.sample_many(rng, faces.data(), faces.size());
+
+    std::map<int, double> frequency;
+    for (auto face : faces)
+    {
+        frequency[face] += 1.0 / draws;
+    }
+    EXPECT_THAT(frequency[1], DoubleNear(0.6, 0.01));
+    EXPECT_THAT(frequency[2], DoubleNear(0.3, 0.01));
+    EXPECT_THAT(frequency[3], DoubleNear(0.1, 0.01));
+}
+
+TEST(custom_die_sampling_test, repeated_faces_weight_a_die)
+{
+    random_number_generator rng{ 11 };
+    custom_die_registry registry;
+    const auto& die = registry.resolve("0,0,1,1,2");
+
+    std::map<int, int> counts;
+    for (int i = 0; i < 100000; ++i)
+    {
+        ++counts[die.sample(rng)];
+    }
+    EXPECT_THAT(counts.size(), Eq(3u));
+    EXPECT_THAT(counts[2] / 100000.0, DoubleNear(0.2, 0.01));
+    EXPECT_THAT(&registry.resolve("0,0,1,1,2"), Eq(&die));
+}
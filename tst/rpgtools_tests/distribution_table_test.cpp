@@ -0,0 +1,166 @@
+#include <gtest\gtest.h>
+#include <gmock\gmock.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "expression_evaluator_test.h"
+#include "rpgtools\distribution_table.h"
+
+using ::testing::_;
+using ::testing::DoubleNear;
+using ::testing::Eq;
+using ::testing::Return;
+using ::testing::StrEq;
+
+using mode = expression_evaluator::dice_selection_mode;
+
+struct distribution_table_test : public expression_evaluator_test
+{
+    std::string path{ (std::filesystem::temp_directory_path() / "rpgtools_distribution_table_test.dist").string() };
+
+    void SetUp() override
+    {
+        write_distribution_table(path, {
+                                           { 2, 6, false, mode::all, 0 },
+                                           { 4, 6, false, mode::best, 3 },
+                                           { 2, 20, false, mode::worst, 1 },
+                                           { 1, 66, false, mode::all, 0 },
+                                       });
+    }
+
+    void TearDown() override
+    {
+        std::remove(path.c_str());
+    }
+};
+
+TEST(compute_distribution_test, two_d6)
+{
+    auto distribution = compute_distribution({ 2, 6, false, mode::all, 0 });
+    EXPECT_THAT(distribution.min_value, Eq(2));
+    EXPECT_THAT(distribution.probabilities.size(), Eq(11u));
+    EXPECT_THAT(distribution.probabilities[7 - 2], DoubleNear(6.0 / 36, 1e-12));
+}
+
+TEST(compute_distribution_test, four_d6_keep_best_3)
+{
+    auto distribution = compute_distribution({ 4, 6, false, mode::best, 3 });
+    double mean = 0.0;
+    for (std::size_t i = 0; i < distribution.probabilities.size(); ++i)
+    {
+        mean += (distribution.min_value + i) * distribution.probabilities[i];
+    }
+    EXPECT_THAT(distribution.min_value, Eq(3));
+    EXPECT_THAT(mean, DoubleNear(15869.0 / 1296, 1e-9));
+    EXPECT_THAT(distribution.probabilities[18 - 3], DoubleNear(21.0 / 1296, 1e-12));
+}
+
+TEST(compute_distribution_test, exploding_dice_are_not_tabulated)
+{
+    EXPECT_THROW(compute_distribution({ 1, 6, true, mode::all, 0 }), std::runtime_error);
+}
+
+TEST_F(distribution_table_test, probability_queries)
+{
+    distribution_table table{ path };
+    EXPECT_THAT(table.size(), Eq(4u));
+    EXPECT_THAT(table.probability_at_least({ 2, 6, false, mode::all, 0 }, 7), DoubleNear(21.0 / 36, 1e-12));
+    EXPECT_THAT(table.probability_at_most({ 2, 6, false, mode::all, 0 }, 3), DoubleNear(3.0 / 36, 1e-12));
+    EXPECT_THAT(table.probability_at_least({ 2, 20, false, mode::worst, 1 }, 20), DoubleNear(1.0 / 400, 1e-12));
+    EXPECT_THAT(table.probability_at_least({ 1, 66, false, mode::all, 0 }, 61), DoubleNear(6.0 / 36, 1e-12));
+    EXPECT_THAT(table.probability_at_least({ 2, 6, false, mode::all, 0 }, 1), Eq(1.0));
+    EXPECT_THAT(table.probability_at_least({ 2, 6, false, mode::all, 0 }, 13), Eq(0.0));
+}
+
+TEST_F(distribution_table_test, lookup_normalizes_terms)
+{
+    distribution_table table{ path };
+    EXPECT_TRUE(table.contains(eval.parse_dice_expression("4d6b3")));
+    EXPECT_TRUE(table.contains(eval.parse_dice_expression("2d6b2")));   // Keeps everything, same as 2d6
+    EXPECT_FALSE(table.contains(eval.parse_dice_expression("2d6!")));
+    EXPECT_FALSE(table.contains(eval.parse_dice_expression("3d6")));
+}
+
+TEST_F(distribution_table_test, sample_uses_inverse_cdf)
+{
+    distribution_table table{ path };
+    const int draw_max = (1 << 30) - 1;
+    EXPECT_CALL(rng, generate(0, draw_max)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_THAT(table.sample({ 2, 6, false, mode::all, 0 }, rng), Eq(2));
+
+    EXPECT_CALL(rng, generate(0, draw_max)).WillOnce(Return(draw_max)).WillOnce(Return(draw_max));
+    EXPECT_THAT(table.sample({ 2, 6, false, mode::all, 0 }, rng), Eq(12));
+
+    // u = 0.5 lands on 7, the first total with P(total <= x) > 0.5
+    EXPECT_CALL(rng, generate(0, draw_max)).WillOnce(Return(1 << 29)).WillOnce(Return(0));
+    EXPECT_THAT(table.sample({ 2, 6, false, mode::all, 0 }, rng), Eq(7));
+}
+
+TEST_F(distribution_table_test, evaluator_samples_without_description)
+{
+    distribution_table table{ path };
+    eval.set_distribution_table(&table);
+
+    EXPECT_CALL(rng, generate(1, 6)).Times(0);
+    EXPECT_CALL(rng, generate(0, (1 << 30) - 1)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_THAT(eval.evaluate("2d6+1"), Eq(3));
+}
+
+TEST_F(distribution_table_test, evaluator_rolls_when_description_requested)
+{
+    distribution_table table{ path };
+    eval.set_distribution_table(&table);
+
+    std::string description;
+    EXPECT_CALL(rng, generate(1, 6)).Times(2).WillOnce(Return(4)).WillOnce(Return(3));
+    EXPECT_THAT(eval.evaluate("2d6", &description), Eq(7));
+    EXPECT_THAT(description, StrEq("(4, 3)"));
+}
+
+TEST_F(distribution_table_test, rejects_other_files)
+{
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "not a distribution table, just some text that is long enough";
+    }
+    EXPECT_THROW(distribution_table{ path }, std::runtime_error);
+}
+
+TEST_F(distribution_table_test, rejects_corrupt_files)
+{
+    std::vector<char> original;
+    {
+        std::ifstream in(path, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    // Header: entries_offset at 24; entries of 24 bytes from 40, with value_count at +12 and data_offset at +16
+    auto write_with = [&](std::size_t offset, std::uint64_t value, std::size_t size) {
+        auto bytes = original;
+        std::memcpy(bytes.data() + offset, &value, size);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    };
+
+    std::uint64_t data_offset{ 0 };
+    std::memcpy(&data_offset, original.data() + 40 + 16, sizeof(data_offset));
+
+    write_with(24, 44, 8);   // Misaligned entry table
+    EXPECT_THROW(distribution_table{ path }, std::runtime_error);
+
+    write_with(40 + 16, data_offset + 4, 8);   // Misaligned probabilities
+    EXPECT_THROW(distribution_table{ path }, std::runtime_error);
+
+    write_with(40 + 16, ~std::uint64_t{ 15 }, 8);   // data_offset + 16 wraps around to 0
+    EXPECT_THROW(distribution_table{ path }, std::runtime_error);
+
+    write_with(40 + 12, 0x10000000, 4);   // Tables run past the end of the file
+    EXPECT_THROW(distribution_table{ path }, std::runtime_error);
+
+    write_with(40, 9, 2);   // First entry's count now sorts after the second's
+    EXPECT_THROW(distribution_table{ path }, std::runtime_error);
+
+    write_with(0, 0, 0);   // Unchanged
+    EXPECT_NO_THROW(distribution_table{ path });
+}
@@ -1,8 +1,11 @@
 #include <gtest\gtest.h>
 #include <gmock\gmock.h>
+#include <algorithm>
 #include "expression_evaluator_test.h"
 
 using ::testing::_;
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::Return;
 using ::testing::StrEq;
@@ -240,7 +243,227 @@ TEST_F(evaluate_test, exploding_dice_dropped_show_explosions)
     EXPECT_THAT(description, StrEq("([6+3], 2, 4)"));
 }
 
-// TODO: Evaluate with a target number with the total
+TEST_F(evaluate_test, evaluate_prefix_matches_evaluate)
+{
+    EXPECT_CALL(rng, generate(1, 6)).Times(2).WillOnce(Return(4)).WillOnce(Return(3));
+    auto prefix = eval.convert_infix_to_prefix(eval.parse("2d6+3"));
+    auto result = eval.evaluate_prefix(prefix, &description);
+    EXPECT_THAT(result, Eq(10));
+    EXPECT_THAT(description, StrEq("(4, 3)"));
+}
+
+TEST_F(evaluate_test, missing_operand_throws)
+{
+    EXPECT_THROW(eval.evaluate("1+", &description), std::runtime_error);
+    EXPECT_THROW(eval.evaluate("", &description), std::runtime_error);
+    EXPECT_THROW(eval.evaluate("1)", &description), std::runtime_error);
+}
+
+TEST_F(evaluate_test, dice_results_follow_description_order)
+{
+    EXPECT_CALL(rng, generate(1, 6)).WillOnce(Return(3)).WillOnce(Return(6)).WillOnce(Return(2));
+    EXPECT_CALL(rng, generate(1, 4)).WillOnce(Return(4));
+    std::vector<expression_evaluator::die_result> dice;
+    auto result = eval.evaluate("2d6!b1+d4", &description, &dice);
+    EXPECT_THAT(result, Eq(12));
+    EXPECT_THAT(description, StrEq("([6+2], 3) (4)"));
+    ASSERT_THAT(dice.size(), Eq(3u));
+    EXPECT_THAT(dice[0].term, Eq(0));
+    EXPECT_THAT(dice[0].total, Eq(8));
+    EXPECT_THAT(dice[0].rolls, Eq(2));
+    EXPECT_TRUE(dice[0].kept);
+    EXPECT_THAT(dice[1].total, Eq(3));
+    EXPECT_FALSE(dice[1].kept);
+    EXPECT_THAT(dice[2].term, Eq(1));
+    EXPECT_THAT(dice[2].total, Eq(4));
+}
+
+TEST_F(evaluate_test, totals_only_exploding_reads_chains_from_packed_digits)
+{
+    // Each draw holds 11 base-6 digits, lowest first; a digit of 5 is an explosion and any other is a final face - 1
+    eval.set_totals_only(true);
+    EXPECT_CALL(rng, generate(0, 362797055)).WillOnce(Return(3 + 5 * 6 + 5 * 36 + 2 * 216 + 4 * 1296));
+    EXPECT_THAT(eval.evaluate("3d6!"), Eq(24));   // 4 + (6+6+3) + 5
+}
+
+TEST_F(evaluate_test, totals_only_continues_chains_past_one_draw)
+{
+    eval.set_totals_only(true);
+    EXPECT_CALL(rng, generate(0, 362797055)).WillOnce(Return(362797055)).WillOnce(Return(0));
+    EXPECT_THAT(eval.evaluate("d6!"), Eq(6 * 11 + 1));
+}
+
+TEST_F(evaluate_test, totals_only_keeps_rolling_when_describing)
+{
+    eval.set_totals_only(true);
+    EXPECT_CALL(rng, generate(1, 6)).WillOnce(Return(6)).WillOnce(Return(2));
+    EXPECT_THAT(eval.evaluate("d6!", &description), Eq(8));
+    EXPECT_THAT(description, StrEq("([6+2])"));
+}
+
+TEST(totals_only_test, matches_rolled_distribution)
+{
+    random_number_generator rng{ 2024 };
+    expression_evaluator rolled{ &rng };
+    expression_evaluator sampled{ &rng };
+    sampled.set_totals_only(true);
+
+    // An exploding d6 averages 3.5 * 6/5 = 4.2
+    const int trials = 2000;
+    double rolled_mean{ 0.0 };
+    double sampled_mean{ 0.0 };
+    for (int i = 0; i < trials; ++i)
+    {
+        rolled_mean += rolled.evaluate("200d6!") / (200.0 * trials);
+        sampled_mean += sampled.evaluate("200d6!") / (200.0 * trials);
+    }
+    EXPECT_THAT(rolled_mean, DoubleNear(4.2, 0.02));
+    EXPECT_THAT(sampled_mean, DoubleNear(4.2, 0.02));
+}
+
+TEST_F(evaluate_test, repetition_draws_each_term_in_bulk)
+{
+    // 3x(4d6b3): all twelve d6 are drawn before any repetition is summed, four per repetition
+    EXPECT_CALL(rng, generate(1, 6))
+        .WillOnce(Return(3)).WillOnce(Return(3)).WillOnce(Return(5)).WillOnce(Return(6))
+        .WillOnce(Return(1)).WillOnce(Return(1)).WillOnce(Return(1)).WillOnce(Return(2))
+        .WillOnce(Return(6)).WillOnce(Return(6)).WillOnce(Return(6)).WillOnce(Return(6));
+    std::vector<int> results;
+    auto sum = eval.evaluate_repeated("3x(4d6b3)", results);
+    EXPECT_THAT(results, ElementsAre(14, 4, 18));
+    EXPECT_THAT(sum, Eq(36));
+}
+
+TEST_F(evaluate_test, repetition_sorts_highest_first)
+{
+    EXPECT_CALL(rng, generate(1, 6)).WillOnce(Return(2)).WillOnce(Return(5)).WillOnce(Return(4));
+    EXPECT_CALL(rng, generate(1, 4)).WillOnce(Return(1)).WillOnce(Return(4)).WillOnce(Return(2));
+    std::vector<int> results;
+    auto sum = eval.evaluate_repeated("3 x (d6+d4-1)", results, true);
+    EXPECT_THAT(results, ElementsAre(8, 5, 2));
+    EXPECT_THAT(sum, Eq(15));
+}
+
+TEST_F(evaluate_test, repetition_keeps_worst)
+{
+    EXPECT_CALL(rng, generate(1, 20)).WillOnce(Return(17)).WillOnce(Return(4)).WillOnce(Return(9)).WillOnce(Return(12));
+    std::vector<int> results;
+    eval.evaluate_repeated("2x2d20w1", results);
+    EXPECT_THAT(results, ElementsAre(4, 9));
+}
+
+TEST_F(evaluate_test, plain_expression_repeats_once)
+{
+    std::size_t count{ 0 };
+    std::string_view inner;
+    EXPECT_FALSE(eval.parse_repetition("2d6+3", count, inner));
+    EXPECT_TRUE(eval.parse_repetition("100x(2d6+3)", count, inner));
+    EXPECT_THAT(count, Eq(100u));
+    EXPECT_THAT(std::string{ inner }, StrEq("(2d6+3)"));
+
+    std::vector<int> results;
+    EXPECT_THAT(eval.evaluate_repeated("7*3", results), Eq(21));
+    EXPECT_THAT(results, ElementsAre(21));
+    EXPECT_THROW(eval.evaluate_repeated("3x(1+)", results), std::runtime_error);
+}
+
+TEST_F(evaluate_test, repetition_count_is_capped)
+{
+    std::size_t count{ 0 };
+    std::string_view inner;
+    EXPECT_TRUE(eval.parse_repetition("1000000x(d6)", count, inner));
+    EXPECT_THAT(count, Eq(1000000u));
+    EXPECT_THROW(eval.parse_repetition("1000001x(d6)", count, inner), std::runtime_error);
+    EXPECT_THROW(eval.parse_repetition("99999999999x(d6)", count, inner), std::runtime_error);
+
+    std::vector<int> results;
+    EXPECT_THROW(eval.evaluate_repeated("2000000000x(d6)", results), std::runtime_error);
+    EXPECT_TRUE(results.empty());
+}
+
+TEST_F(evaluate_test, repetition_sum_does_not_overflow)
+{
+    std::vector<int> results;
+    EXPECT_THAT(eval.evaluate_repeated("3x(1000000000+1000000000)", results), Eq(6000000000LL));
+    EXPECT_THAT(results, ElementsAre(2000000000, 2000000000, 2000000000));
+}
+
+TEST_F(evaluate_test, check_reports_pass_and_margin)
+{
+    EXPECT_CALL(rng, generate(1, 20)).WillOnce(Return(12)).WillOnce(Return(7));
+    auto check = eval.evaluate_check("1d20+7>=15", &description);
+    EXPECT_THAT(check.total, Eq(19));
+    EXPECT_THAT(check.target, Eq(15));
+    EXPECT_TRUE(check.success);
+    EXPECT_THAT(check.margin, Eq(4));
+    EXPECT_THAT(description, StrEq("(12)"));
+
+    check = eval.evaluate_check("1d20+7 >= 15");
+    EXPECT_FALSE(check.success);
+    EXPECT_THAT(check.margin, Eq(-1));
+}
+
+TEST_F(evaluate_test, check_margin_favours_low_rolls_for_at_most)
+{
+    EXPECT_CALL(rng, generate(1, 100)).WillOnce(Return(23)).WillOnce(Return(60));
+    auto check = eval.evaluate_check("d100<=45");
+    EXPECT_TRUE(check.success);
+    EXPECT_THAT(check.margin, Eq(22));
+
+    check = eval.evaluate_check("d100<45");
+    EXPECT_FALSE(check.success);
+    EXPECT_THAT(check.margin, Eq(-15));
+}
+
+TEST_F(evaluate_test, comparisons_yield_one_or_zero)
+{
+    EXPECT_CALL(rng, generate(1, 6)).WillOnce(Return(5)).WillOnce(Return(6)).WillOnce(Return(2));
+    EXPECT_THAT(eval.evaluate("(d6>4)+(d6=6)+(d6>=3)"), Eq(2));
+    EXPECT_THAT(eval.evaluate("2*3<7"), Eq(1));
+    EXPECT_THROW(eval.evaluate_check("2*3"), std::runtime_error);
+    EXPECT_THROW(eval.evaluate_check(">=3"), std::runtime_error);
+}
+
+TEST_F(evaluate_test, only_an_outermost_comparison_is_a_check)
+{
+    EXPECT_TRUE(eval.is_check("1d20+7>=15"));
+    EXPECT_TRUE(eval.is_check("(d6>4)+(d6>4)>=1"));
+    EXPECT_FALSE(eval.is_check("(d6>4)+(d6>4)"));
+    EXPECT_FALSE(eval.is_check("2d6+3"));
+}
+
+TEST(repetition_test, matches_single_evaluations)
+{
+    random_number_generator rng{ 2024 };
+    expression_evaluator eval{ &rng };
+
+    // 4d6b3 averages 12.2446
+    std::vector<int> results;
+    auto sum = eval.evaluate_repeated("20000x(4d6b3)", results);
+    ASSERT_THAT(results.size(), Eq(20000u));
+    EXPECT_THAT(*std::min_element(results.begin(), results.end()), Eq(3));
+    EXPECT_THAT(*std::max_element(results.begin(), results.end()), Eq(18));
+    EXPECT_THAT(sum / 20000.0, DoubleNear(12.2446, 0.05));
+}
+
+TEST(repetition_test, works_through_large_counts_in_batches)
+{
+    random_number_generator rng{ 2024 };
+    expression_evaluator eval{ &rng };
+
+    // More repetitions than one batch holds, and repetitions with more dice than one batch holds
+    std::vector<int> results;
+    auto sum = eval.evaluate_repeated("200000x(d6+d{0,1})", results);
+    ASSERT_THAT(results.size(), Eq(200000u));
+    EXPECT_THAT(*std::min_element(results.begin(), results.end()), Eq(1));
+    EXPECT_THAT(*std::max_element(results.begin(), results.end()), Eq(7));
+    EXPECT_THAT(sum / 200000.0, DoubleNear(4.0, 0.02));
+
+    sum = eval.evaluate_repeated("3x(100000d2)", results);
+    ASSERT_THAT(results.size(), Eq(3u));
+    EXPECT_THAT(sum / 3.0, DoubleNear(150000.0, 1000.0));
+}
+
 // TODO: Division with a round down ala raises in Savage Worlds
 // TODO: Count results higher than a certain value, ala 6 is success in year zero
 // TODO: Support different kinds of dice, like 2d6[attribute]3d6[skill]4d6[stress]
@@ -8,6 +8,15 @@ class mock_random_number_generator : public random_number_generator
 {
 public:
     MOCK_METHOD(int, generate, (int min, int max), (override));
+
+    // Route bulk requests through the mocked generate() so expectations see every draw
+    void generate_many(int min, int max, int* first, std::size_t count) override
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            first[i] = generate(min, max);
+        }
+    }
 };
 
 struct expression_evaluator_test : public ::testing::Test
@@ -52,6 +52,9 @@ INSTANTIATE_TEST_SUITE_P(
         { "1d20b1+7", std::vector<std::string>{ "1d20b1", "+", "7" }, std::vector<std::string>{ "1d20b1", "7", "+" } },
         { "(1d20b1+7)-3", std::vector<std::string>{ "(", "1d20b1", "+", "7", ")", "-", "3" }, std::vector<std::string>{ "1d20b1", "7", "+", "3", "-" } },
         { "(1*1d10)+(1*1d10)+1", std::vector<std::string>{ "(", "1", "*", "1d10", ")", "+", "(", "1", "*", "1d10", ")", "+", "1" }, std::vector<std::string>{ "1", "1d10", "*", "1", "1d10", "*", "+", "1", "+" } },
+        { "1d20+7>=15", std::vector<std::string>{ "1d20", "+", "7", ">=", "15" }, std::vector<std::string>{ "1d20", "7", "+", "15", ">=" } },
+        { "2d6 < 3*2", std::vector<std::string>{ "2d6", "<", "3", "*", "2" }, std::vector<std::string>{ "2d6", "3", "2", "*", "<" } },
+        { "(1d6>4)+(1d6=6)", std::vector<std::string>{ "(", "1d6", ">", "4", ")", "+", "(", "1d6", "=", "6", ")" }, std::vector<std::string>{ "1d6", "4", ">", "1d6", "6", "=", "+" } },
         // clang-format on
     }
 ));
\ No newline at end of file
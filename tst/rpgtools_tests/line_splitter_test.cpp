@@ -0,0 +1,54 @@
+#include <gtest\gtest.h>
+#include <gmock\gmock.h>
+#include <string>
+#include <vector>
+#include "rolld\line_splitter.h"
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+// Feeds each chunk in turn and records one entry per response rolld would send
+struct line_splitter_test : public ::testing::Test
+{
+    line_splitter lines{ 8 };
+    std::vector<std::string> responses;
+
+    void feed(std::string_view chunk)
+    {
+        lines.feed(
+            chunk, [&](std::string_view line) { responses.emplace_back(line); },
+            [&]() { responses.emplace_back("<too long>"); });
+    }
+};
+
+TEST_F(line_splitter_test, lines_may_span_reads)
+{
+    feed("1d6\n2d");
+    feed("6+3\r");
+    feed("\n4d6b3\r\n");
+    EXPECT_THAT(responses, ElementsAre("1d6", "2d6+3", "4d6b3"));
+    EXPECT_THAT(lines.buffered(), Eq(0u));
+}
+
+TEST_F(line_splitter_test, complete_overlong_line_is_rejected)
+{
+    feed("1d6\n123456789\n12345678\n");
+    EXPECT_THAT(responses, ElementsAre("1d6", "<too long>", "12345678"));
+}
+
+TEST_F(line_splitter_test, overlong_line_across_reads_gets_one_response)
+{
+    feed("1d6\n12345");
+    feed("67890");
+    feed("abcdef");
+    feed("ghi\n2d6\n");
+    EXPECT_THAT(responses, ElementsAre("1d6", "<too long>", "2d6"));
+    EXPECT_THAT(lines.buffered(), Eq(0u));
+}
+
+TEST_F(line_splitter_test, carriage_return_does_not_count)
+{
+    feed("12345678\r");
+    feed("\n");
+    EXPECT_THAT(responses, ElementsAre("12345678"));
+}
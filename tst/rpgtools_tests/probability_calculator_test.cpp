@@ -0,0 +1,103 @@
+#include <gtest\gtest.h>
+#include <gmock\gmock.h>
+#include "rpgtools\probability_calculator.h"
+
+using ::testing::DoubleNear;
+using ::testing::Eq;
+using ::testing::Le;
+
+const double tolerance = 1e-12;
+
+struct probability_calculator_test : public ::testing::Test
+{
+    probability_calculator calculator;
+};
+
+TEST_F(probability_calculator_test, attack_roll_against_armor_class)
+{
+    // Needs 8 or better on the d20
+    EXPECT_THAT(calculator.probability("1d20+7", ">=", 15), DoubleNear(13.0 / 20, tolerance));
+    EXPECT_THAT(calculator.probability("1d20+7", ">=", 8), DoubleNear(1.0, tolerance));
+    EXPECT_THAT(calculator.probability("1d20+7", ">=", 28), DoubleNear(0.0, tolerance));
+}
+
+TEST_F(probability_calculator_test, every_comparison)
+{
+    EXPECT_THAT(calculator.probability("2d6", "=", 7), DoubleNear(6.0 / 36, tolerance));
+    EXPECT_THAT(calculator.probability("2d6", ">", 7), DoubleNear(15.0 / 36, tolerance));
+    EXPECT_THAT(calculator.probability("2d6", "<=", 4), DoubleNear(6.0 / 36, tolerance));
+    EXPECT_THAT(calculator.probability("2d6", "<", 2), DoubleNear(0.0, tolerance));
+    EXPECT_THROW(calculator.probability("2d6", "!=", 7), std::runtime_error);
+}
+
+TEST_F(probability_calculator_test, batch_answers_in_query_order)
+{
+    std::vector<success_query> queries{
+        { "1d20+7", 15 },
+        { "1d20+7", 20 },
+        { "4d6b3", 18 },
+        { "1d20+7", 15, "<" },
+        { "4dF", 0, "=" },
+    };
+    auto results = calculator.probabilities(queries);
+    ASSERT_THAT(results.size(), Eq(5u));
+    EXPECT_THAT(results[0], DoubleNear(13.0 / 20, tolerance));
+    EXPECT_THAT(results[1], DoubleNear(8.0 / 20, tolerance));
+    EXPECT_THAT(results[2], DoubleNear(21.0 / 1296, tolerance));   // At least three sixes
+    EXPECT_THAT(results[3], DoubleNear(7.0 / 20, tolerance));
+    EXPECT_THAT(results[4], DoubleNear(19.0 / 81, 1e-9));          // Alias table weights are 31-bit
+}
+
+TEST_F(probability_calculator_test, exploding_dice)
+{
+    EXPECT_THAT(calculator.probability("d6!", ">=", 7), DoubleNear(1.0 / 6, tolerance));
+    EXPECT_THAT(calculator.probability("d6!", ">=", 13), DoubleNear(1.0 / 36, tolerance));
+    EXPECT_THAT(calculator.probability("d6!", "=", 6), DoubleNear(0.0, tolerance));
+    EXPECT_THROW(calculator.probability("2d6!b1", ">=", 4), std::runtime_error);
+}
+
+TEST_F(probability_calculator_test, expressions_combine_terms)
+{
+    EXPECT_THAT(calculator.probability("d6*d6", "=", 36), DoubleNear(1.0 / 36, tolerance));
+    EXPECT_THAT(calculator.probability("d6-d6", "=", 0), DoubleNear(1.0 / 6, tolerance));
+
+    // Count of two d6 showing 5 or 6
+    auto successes = calculator.distribution("(d6>=5)+(d6>=5)");
+    EXPECT_THAT(successes.min_value, Eq(0));
+    ASSERT_THAT(successes.probabilities.size(), Eq(3u));
+    EXPECT_THAT(successes.probabilities[2], DoubleNear(1.0 / 9, tolerance));
+    EXPECT_THAT(successes.probabilities[0], DoubleNear(4.0 / 9, tolerance));
+}
+
+TEST_F(probability_calculator_test, keeping_no_dice_totals_zero)
+{
+    // The evaluator rolls d6b and 4d6!w0 as 0 too
+    EXPECT_THAT(calculator.probability("d6b", "=", 0), DoubleNear(1.0, tolerance));
+    EXPECT_THAT(calculator.probability("4d6!w0+3", "=", 3), DoubleNear(1.0, tolerance));
+    EXPECT_THAT(calculator.probability("4d{1,2}b0", ">", 0), DoubleNear(0.0, tolerance));
+}
+
+TEST_F(probability_calculator_test, wide_terms_are_rejected)
+{
+    EXPECT_THROW(calculator.probability("1000d1000", ">=", 500000), std::runtime_error);
+    EXPECT_THROW(calculator.probability("200d{0,1000}", ">=", 1000), std::runtime_error);
+    EXPECT_THROW(calculator.probability("20000d6!", ">=", 70000), std::runtime_error);
+    EXPECT_THROW(calculator.probability("200d200b100", ">=", 100), std::runtime_error);
+
+    // One die, but with faces far apart
+    EXPECT_THROW(calculator.probability("d{0,100000000}", ">=", 1), std::runtime_error);
+    EXPECT_THROW(calculator.probability("d{-2000000000,2000000000}", ">=", 1), std::runtime_error);
+    EXPECT_THROW(calculator.probability("d2000000000!", ">=", 1), std::runtime_error);
+    EXPECT_THAT(calculator.probability("d{0,60000}", ">=", 1), DoubleNear(0.5, 1e-9));
+    EXPECT_THAT(calculator.probability("100d100", ">=", 1), DoubleNear(1.0, tolerance));
+}
+
+TEST_F(probability_calculator_test, table_cache_is_bounded)
+{
+    for (int i = 0; i < 3000; ++i)
+    {
+        auto expression = "d6+" + std::to_string(i);
+        EXPECT_THAT(calculator.probability(expression, "=", i + 6), DoubleNear(1.0 / 6, tolerance));
+        EXPECT_THAT(calculator.cached_tables(), Le(probability_calculator::max_cached_tables));
+    }
+}
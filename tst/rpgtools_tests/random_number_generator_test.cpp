@@ -0,0 +1,39 @@
+#include <gtest\gtest.h>
+#include <gmock\gmock.h>
+#include <algorithm>
+#include <vector>
+#include "rpgtools\random_number_generator.h"
+
+using ::testing::AllOf;
+using ::testing::Each;
+using ::testing::Ge;
+using ::testing::Le;
+
+TEST(random_number_generator_test, generate_many_stays_in_range)
+{
+    random_number_generator rng;
+    std::vector<int> values(1000);
+    rng.generate_many(1, 6, values.data(), values.size());
+    EXPECT_THAT(values, Each(AllOf(Ge(1), Le(6))));
+}
+
+TEST(random_number_generator_test, generate_many_covers_every_face)
+{
+    random_number_generator rng;
+    std::vector<int> values(1000);
+    rng.generate_many(1, 4, values.data(), values.size());
+    for (int face = 1; face <= 4; ++face)
+    {
+        EXPECT_NE(std::find(values.begin(), values.end(), face), values.end()) << "face " << face;
+    }
+}
+
+TEST(random_number_generator_test, seeded_generators_repeat)
+{
+    random_number_generator first{ 1234 };
+    random_number_generator second{ 1234 };
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(first.generate(1, 20), second.generate(1, 20));
+    }
+}
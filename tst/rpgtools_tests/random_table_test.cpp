@@ -0,0 +1,127 @@
+#include <gtest\gtest.h>
+#include <gmock\gmock.h>
+#include "expression_evaluator_test.h"
+#include "rpgtools\random_table.h"
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Return;
+using ::testing::StrEq;
+
+struct random_table_test : public expression_evaluator_test
+{
+    random_table_set tables{ &rng };
+
+    const char* encounters = "# Encounters on the road\n"
+                             "table encounter d66\n"
+                             "11-16  {d6+1} wolves\n"
+                             "21-36  A traveller carrying [trinket]\n"
+                             "41-66  Nothing\n"
+                             "\n"
+                             "table trinket d6\n"
+                             "1-3    a brass key\n"
+                             "4-6    {2d6} silver coins\n";
+};
+
+TEST_F(random_table_test, lookup_is_by_roll_range)
+{
+    tables.load_string(encounters);
+
+    const auto& encounter = tables.get("encounter");
+    EXPECT_THAT(tables.size(), Eq(2u));
+    EXPECT_THAT(encounter.lookup(11).text, StrEq("{d6+1} wolves"));
+    EXPECT_THAT(encounter.lookup(36).text, StrEq("A traveller carrying [trinket]"));
+    EXPECT_THAT(encounter.lookup(52).text, StrEq("Nothing"));
+    EXPECT_THROW(encounter.lookup(17), std::runtime_error);
+    EXPECT_THROW(encounter.lookup(67), std::runtime_error);
+}
+
+TEST_F(random_table_test, roll_resolves_expressions)
+{
+    tables.load_string(encounters);
+
+    EXPECT_CALL(rng, generate(1, 6))
+        .WillOnce(Return(1))    // d66 tens
+        .WillOnce(Return(4))    // d66 units
+        .WillOnce(Return(5));   // d6+1
+    EXPECT_THAT(tables.roll("encounter"), StrEq("6 wolves"));
+}
+
+TEST_F(random_table_test, roll_follows_table_references)
+{
+    tables.load_string(encounters);
+
+    EXPECT_CALL(rng, generate(1, 6))
+        .WillOnce(Return(2))    // d66 tens
+        .WillOnce(Return(2))    // d66 units
+        .WillOnce(Return(6))    // trinket
+        .WillOnce(Return(3))    // 2d6
+        .WillOnce(Return(4));
+    EXPECT_THAT(tables.roll("encounter"), StrEq("A traveller carrying 7 silver coins"));
+}
+
+TEST_F(random_table_test, expressions_may_contain_custom_dice)
+{
+    tables.load_string("table t d6\n1-6 {3d{0,1}+1} boosts\n");
+
+    // The second and third words land in the second column of d{0,1}
+    EXPECT_CALL(rng, generate(1, 6)).WillOnce(Return(2));
+    EXPECT_CALL(rng, generate(0, 2147483647))
+        .WillOnce(Return(0))
+        .WillOnce(Return(2147483647))
+        .WillOnce(Return(2147483647));
+    EXPECT_THAT(tables.roll("t"), StrEq("3 boosts"));
+
+    EXPECT_THROW(tables.load_string("table u d6\n1-6 {d{0,1} unclosed\n"), std::runtime_error);
+}
+
+TEST_F(random_table_test, malformed_expressions_fail_to_load)
+{
+    EXPECT_THROW(tables.load_string("table t d6\n1-6 {1+} coins\n"), std::runtime_error);
+    EXPECT_THROW(tables.load_string("table t d6\n1-6 {2 3} coins\n"), std::runtime_error);
+    EXPECT_THROW(tables.load_string("table t d6\n1-6 {2d6+1dx} coins\n"), std::runtime_error);
+    EXPECT_THROW(tables.load_string("table t d6\n1-6 {} coins\n"), std::runtime_error);
+}
+
+TEST_F(random_table_test, roll_many_draws_in_bulk)
+{
+    tables.load_string(encounters);
+
+    EXPECT_CALL(rng, generate(1, 6))
+        .WillOnce(Return(4))    // first d66
+        .WillOnce(Return(1))
+        .WillOnce(Return(6))    // second d66
+        .WillOnce(Return(6))
+        .WillOnce(Return(1))    // third d66
+        .WillOnce(Return(2))
+        .WillOnce(Return(2));   // d6+1 for the wolves
+
+    std::vector<std::string> results;
+    tables.roll_many("encounter", 3, results);
+    EXPECT_THAT(results, ElementsAre("Nothing", "Nothing", "3 wolves"));
+}
+
+TEST_F(random_table_test, every_roll_needs_an_entry)
+{
+    EXPECT_THROW(tables.load_string("table t d6\n1-3 low\n5-6 high\n"), std::runtime_error);
+}
+
+TEST_F(random_table_test, overlapping_ranges_throw)
+{
+    EXPECT_THROW(tables.load_string("table t d6\n1-4 low\n4-6 high\n"), std::runtime_error);
+}
+
+TEST_F(random_table_test, unknown_reference_leaves_set_unchanged)
+{
+    EXPECT_THROW(tables.load_string("table t d6\n1-6 [missing]\n"), std::runtime_error);
+    EXPECT_THAT(tables.size(), Eq(0u));
+    EXPECT_FALSE(tables.contains("t"));
+}
+
+TEST_F(random_table_test, reference_cycles_throw)
+{
+    tables.load_string("table a d6\n1-6 [b]\ntable b d6\n1-6 [a]\n");
+
+    EXPECT_CALL(rng, generate(1, 6)).WillRepeatedly(Return(1));
+    EXPECT_THROW(tables.roll("a"), std::runtime_error);
+}